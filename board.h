@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+The thin layer between the controller and the outside world. Everything in controller.cpp goes through
+these functions instead of touching mbed objects directly, which is what lets the same controller code
+run on the LPC1768 (board_mbed.cpp) or on a workstation against a simulated actuator (sim/board_sim.cpp).
+*/
+
+void boardInit ();
+// Axis 0 is the original load cell (p20) and actuator (the DAC on p18); any others are on the spare ADC pins and PWM
+// outputs (see board_mbed.cpp).
+float readForce (int axis); // The load-cell amplifier voltage, normalized 0-1 the same way AnalogIn::read() is.
+uint16_t readForceRaw (int axis); // The same reading, 0-0xFFFF like AnalogIn::read_u16(), for the fixed-point engine.
+void writeActuator (int axis, float position); // 0-1, same as AnalogOut::write().
+void writeActuatorRaw (int axis, uint16_t position); // 0-0xFFFF, same as AnalogOut::write_u16().
+bool readMaster ();
+// fromMaster's edges, oldest first, each stamped with clockUs() by the pin interrupt. False once there are none left.
+struct MasterEdge {
+    uint32_t timeUs;
+    bool rising;
+};
+bool popMasterEdge (MasterEdge &edge);
+bool masterEdgesLost (); // Whether an edge didn't fit since the last call, which is what tells you the pin should win.
+uint64_t clockMs ();
+uint32_t clockUs (); // Free-running, wraps every ~71 minutes. Only good for differences.
+void sleepMs (uint32_t ms);
+void startTicker (uint32_t periodUs);
+uint32_t waitForTicker (); // Blocks until the next ticker interrupt; returns how many fired since the last call.
+/*
+Streaming: the board plays a buffer of positions out to axis 0's actuator at a fixed rate, by itself. While a stream
+is running, nothing else should write that actuator. Stopping one early leaves the output wherever it got to.
+*/
+uint32_t dacStreamCapacity ();
+void setDacStreamSample (uint32_t index, uint16_t position); // 0-0xFFFF, like writeActuatorRaw()
+void startDacStream (uint32_t count, uint32_t rateHz);
+uint32_t dacStreamProgress (); // How many samples have gone out so far; count once it's finished.
+void stopDacStream ();
+uint32_t cycleCount (); // CPU cycles (the DWT counter) on target; nanoseconds on the simulator.
+uint32_t cycleCountHz ();
+void startBackgroundTask (void (*task)(), uint32_t periodMs); // Runs task every periodMs, below the control loop's priority.
+// On target, only with telemetry on: it's the only user, and the thread's stack is static.
+// Starts loop in its own thread, above everything else's priority. loop never returns.
+void startControlThread (void (*loop)());
+/*
+The watchdog resets the chip if kickWatchdog() isn't called for timeoutMs. Before that, the ticker interrupt calls
+onStall (once, until the next waitForTicker()) when it finds stallTicks ticks waiting that nobody's taken.
+*/
+void startWatchdog (uint32_t timeoutMs, uint32_t stallTicks, void (*onStall)());
+void kickWatchdog ();
+bool resetByWatchdog (); // Whether the last reset was the watchdog's.
+// Each thread's stack: its size and the most of it that's ever been used. Fills in up to max; returns how many.
+struct ThreadStack {
+    const char *name;
+    uint32_t size;
+    uint32_t highWater;
+};
+int threadStacks (ThreadStack *stacks, int max);
+void writeTelemetry (const uint8_t *bytes, uint32_t length); // Blocks until sent, so only from the background task.
+int readConsole (); // A character typed on the serial console, or -1 if there isn't one. Never blocks.
+// Somewhere that survives a power cycle for one small record (calibration.cpp's). False if it couldn't be read or written.
+bool loadCalibrationRecord (void *record, uint32_t length);
+bool saveCalibrationRecord (const void *record, uint32_t length);
@@ -0,0 +1,476 @@
+#include "board.h"
+#include "config.h"
+#include "AnalogIn.h"
+#include "AnalogOut.h"
+#include "BufferedSerial.h"
+#include "InterruptIn.h"
+#include "EventFlags.h"
+#include "FlashIAP.h"
+#include "Kernel.h"
+#include "PinNames.h"
+#include "PwmOut.h"
+#include "ThisThread.h"
+#include "Thread.h"
+#include "Ticker.h"
+#include "Watchdog.h"
+#include "mbed.h"
+#include "spscring.h"
+#include "platform/mbed_atomic.h"
+#include "platform/mbed_retarget.h"
+#include "platform/mbed_stats.h"
+#include "us_ticker_api.h"
+
+AnalogIn fromAmp (p20);
+AnalogOut toActuator (p18);
+InterruptIn fromMaster (MBED_CONF_APP_MASTER_PIN);
+// us_ticker_read() is the first thing each handler does, so the stamp is only the interrupt's entry latency late.
+static SpscRing<MasterEdge, 32> masterEdges;
+static volatile bool masterEdgeLost {false};
+#if MBED_CONF_APP_AXES > 1
+/*
+The other axes: load cells on the spare ADC inputs, actuators on PWM. There's only the one DAC, so each PWM output
+needs an RC low-pass (or swap in an external DAC) to turn it back into a voltage. At 20kHz the PWM counter, clocked
+at 24MHz, has 1200 steps: about what the DAC has.
+*/
+static_assert(MBED_CONF_APP_AXES <= 4, "Only enough spare pins for four axes");
+static_assert(!MBED_CONF_APP_ADC_DMA_BURST, "Burst sampling only covers axis 0, and reading any other input stops it");
+const int pwmPeriodUs {50};
+AnalogIn fromAmp1 (p17);
+PwmOut toActuator1 (p21);
+#if MBED_CONF_APP_AXES > 2
+AnalogIn fromAmp2 (p16);
+PwmOut toActuator2 (p22);
+#endif
+#if MBED_CONF_APP_AXES > 3
+AnalogIn fromAmp3 (p15);
+PwmOut toActuator3 (p23);
+#endif
+static AnalogIn *const extraAmps[] {
+    &fromAmp1,
+#if MBED_CONF_APP_AXES > 2
+    &fromAmp2,
+#endif
+#if MBED_CONF_APP_AXES > 3
+    &fromAmp3,
+#endif
+};
+static PwmOut *const extraActuators[] {
+    &toActuator1,
+#if MBED_CONF_APP_AXES > 2
+    &toActuator2,
+#endif
+#if MBED_CONF_APP_AXES > 3
+    &toActuator3,
+#endif
+};
+#endif
+/*
+Static stacks, so they're in the map file's RAM total, not quietly taken from the heap. main()'s is
+rtos.main-thread-stack-size, in mbed_app.json. 's' on the console prints how much of each has ever been used.
+Interrupts run on the MSP, not on these. The sizes are from adding up the deepest call chains' frames:
+- control: calibrate() -> seekLimit() -> printf() into the buffered console, or saveCalibration() into FlashIAP, at
+  around 800 bytes. The loop itself, controlStep() -> stepMove() -> planTrajectory(), is about half that.
+- background: drainTelemetry()'s 16-frame batch -> BufferedSerial::write(), around 500.
+Both with about a half again spare, until 's' has a reading from the board to trim them to.
+*/
+MBED_ALIGN(8) static unsigned char controlStack[MBED_CONF_APP_CONTROL_STACK_SIZE];
+static Thread controlThread (osPriorityRealtime, sizeof(controlStack), controlStack, "control");
+#if MBED_CONF_APP_TELEMETRY
+// Telemetry's the only thing that runs in the background, so without it there's no stack to pay for.
+MBED_ALIGN(8) static unsigned char backgroundStack[MBED_CONF_APP_BACKGROUND_STACK_SIZE];
+static Thread backgroundThread (osPriorityLow, sizeof(backgroundStack), backgroundStack, "background");
+static void (*backgroundTask)();
+static uint32_t backgroundPeriodMs;
+BufferedSerial telemetrySerial (MBED_CONF_APP_TELEMETRY_TX, NC, MBED_CONF_APP_TELEMETRY_BAUD);
+#endif
+static Ticker controlTicker;
+static EventFlags tickFlags;
+static uint32_t ticksPending {};
+static uint32_t stallTicks {UINT32_MAX};
+static void (*stallHandler)();
+static bool stallRaised {false};
+
+static void onMasterRise () {
+    if (!masterEdges.push(MasterEdge {us_ticker_read(), true})) {
+        masterEdgeLost = true;
+    }
+}
+
+static void onMasterFall () {
+    if (!masterEdges.push(MasterEdge {us_ticker_read(), false})) {
+        masterEdgeLost = true;
+    }
+}
+
+void onControlTick () {
+    uint32_t pending = core_util_atomic_incr_u32(&ticksPending, 1);
+    tickFlags.set(1);
+    if (pending > stallTicks && !stallRaised && stallHandler != nullptr) {
+        stallRaised = true;
+        stallHandler();
+    }
+}
+
+#if MBED_CONF_APP_ADC_DMA_BURST
+/*
+Burst-mode sampling: the ADC converts p20 (AD0.5) back to back, about every 5us, and GPDMA channel 0 copies each
+result into adcRing. The channel's linked list item points at itself, so it goes round the ring forever without
+the CPU doing anything. A read just averages the newest adc-oversample results, which takes the conversion off the
+control loop's critical path and buys a few bits of resolution back from the noise.
+fromAmp is still constructed (it sets up the pin and powers the ADC), but must never be read in this mode:
+AnalogIn::read() would take the ADC out of burst mode.
+*/
+const int adcRingSize {256}; // Power of two, and comfortably bigger than adc-oversample.
+static_assert(MBED_CONF_APP_ADC_OVERSAMPLE > 0 && MBED_CONF_APP_ADC_OVERSAMPLE <= adcRingSize / 2, "adc-oversample out of range");
+const uint32_t adcChannel {5};
+const uint32_t dmaRequestADC {4};
+struct DmaLinkedListItem {
+    uint32_t source;
+    uint32_t destination;
+    uint32_t next;
+    uint32_t control;
+};
+static volatile uint32_t adcRing[adcRingSize];
+static DmaLinkedListItem adcLoop;
+
+static void startBurstSampling () {
+    LPC_SC->PCONP |= 1 << 29; // GPDMA
+    LPC_GPDMA->DMACConfig = 1;
+    LPC_GPDMA->DMACIntTCClear = 1 << 0;
+    LPC_GPDMA->DMACIntErrClr = 1 << 0;
+    uint32_t control = adcRingSize // Transfer size
+        | 2 << 18                  // Source width: word
+        | 2 << 21                  // Destination width: word
+        | 1u << 27;                // Increment the destination, not the source
+    adcLoop = {(uint32_t)&LPC_ADC->ADDR5, (uint32_t)adcRing, (uint32_t)&adcLoop, control};
+    LPC_GPDMACH0->DMACCSrcAddr = adcLoop.source;
+    LPC_GPDMACH0->DMACCDestAddr = adcLoop.destination;
+    LPC_GPDMACH0->DMACCLLI = adcLoop.next;
+    LPC_GPDMACH0->DMACCControl = control;
+    LPC_GPDMACH0->DMACCConfig = 1   // Enable
+        | dmaRequestADC << 1        // Source peripheral
+        | 2 << 11;                  // Peripheral to memory
+    // Keep whatever clock divider AnalogIn picked; select only our channel, and run it continuously.
+    // In burst mode it's the channel's ADINTEN bit (with the global one off) that raises the DMA request.
+    LPC_ADC->ADINTEN = 1 << adcChannel;
+    LPC_ADC->ADCR = (LPC_ADC->ADCR & 0xFF00) | 1 << adcChannel | 1 << 16 | 1 << 21;
+}
+
+static uint32_t sumNewestSamples () {
+    // The destination register is where the next result will go, so the newest is just behind it.
+    uint32_t next = (LPC_GPDMACH0->DMACCDestAddr - (uint32_t)adcRing) / sizeof(uint32_t);
+    uint32_t sum {0};
+    for (int i = 1; i <= MBED_CONF_APP_ADC_OVERSAMPLE; ++i) {
+        sum += (adcRing[(next - i) & (adcRingSize - 1)] >> 4) & 0xFFF;
+    }
+    return sum;
+}
+#endif
+
+#if MBED_CONF_APP_DAC_STREAMING
+/*
+Streamed moves use the DAC's own DMA support: its counter (DACCNTVAL) paces the updates, and each one raises a
+request that has GPDMA channel 1 feed it the next word from dacStream, which is kept in DACR's own layout.
+*/
+const uint32_t dmaRequestDAC {7};
+static uint32_t dacStream[MBED_CONF_APP_DAC_STREAM_SIZE];
+static_assert(MBED_CONF_APP_DAC_STREAM_SIZE <= 4095, "DMACCControl's transfer size is only 12 bits");
+static uint32_t dacStreamCount {};
+
+static uint32_t dacClockHz () {
+    switch ((LPC_SC->PCLKSEL0 >> 22) & 3) {
+        case 1: return SystemCoreClock;
+        case 2: return SystemCoreClock / 2;
+        case 3: return SystemCoreClock / 8;
+        default: return SystemCoreClock / 4;
+    }
+}
+#endif
+
+uint32_t dacStreamCapacity () {
+#if MBED_CONF_APP_DAC_STREAMING
+    return MBED_CONF_APP_DAC_STREAM_SIZE;
+#else
+    return 0;
+#endif
+}
+
+void setDacStreamSample (uint32_t index, uint16_t position) {
+#if MBED_CONF_APP_DAC_STREAMING
+    // DACR's VALUE field is bits 15:6, so a write_u16()-style value just needs its low bits dropped.
+    dacStream[index] = position & 0xFFC0;
+#endif
+}
+
+void startDacStream (uint32_t count, uint32_t rateHz) {
+#if MBED_CONF_APP_DAC_STREAMING
+    stopDacStream();
+    dacStreamCount = count;
+    LPC_SC->PCONP |= 1 << 29; // GPDMA
+    LPC_GPDMA->DMACConfig = 1;
+    LPC_GPDMA->DMACIntTCClear = 1 << 1;
+    LPC_GPDMA->DMACIntErrClr = 1 << 1;
+    LPC_GPDMACH1->DMACCSrcAddr = (uint32_t)dacStream;
+    LPC_GPDMACH1->DMACCDestAddr = (uint32_t)&LPC_DAC->DACR;
+    LPC_GPDMACH1->DMACCLLI = 0;
+    LPC_GPDMACH1->DMACCControl = (count & 0xFFF) // Transfer size
+        | 2 << 18                                // Source width: word
+        | 2 << 21                                // Destination width: word
+        | 1u << 26;                              // Increment the source, not the destination
+    LPC_GPDMACH1->DMACCConfig = 1   // Enable
+        | dmaRequestDAC << 6        // Destination peripheral
+        | 1 << 11;                  // Memory to peripheral
+    uint32_t ticks = dacClockHz() / rateHz;
+    LPC_DAC->DACCNTVAL = ticks > 0xFFFF ? 0xFFFF : ticks;
+    LPC_DAC->DACCTRL = 1 << 1 // Double buffering, so each value goes out on a counter timeout, not when it's written
+        | 1 << 2              // Counter
+        | 1 << 3;             // DMA
+#endif
+}
+
+uint32_t dacStreamProgress () {
+#if MBED_CONF_APP_DAC_STREAMING
+    if ((LPC_GPDMA->DMACEnbldChns & (1 << 1)) == 0) {
+        return dacStreamCount;
+    }
+    return (LPC_GPDMACH1->DMACCSrcAddr - (uint32_t)dacStream) / sizeof(uint32_t);
+#else
+    return 0;
+#endif
+}
+
+void stopDacStream () {
+#if MBED_CONF_APP_DAC_STREAMING
+    uint32_t played = dacStreamProgress();
+    LPC_GPDMACH1->DMACCConfig &= ~1u;
+    // Back to plain writes, so AnalogOut goes straight to the output again.
+    LPC_DAC->DACCTRL = 0;
+    dacStreamCount = played;
+#endif
+}
+
+void boardInit () {
+// The pin objects above are set up by their constructors. This just turns on the cycle counter and fromMaster's
+// interrupts (and, if asked for, burst sampling).
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    fromMaster.rise(onMasterRise);
+    fromMaster.fall(onMasterFall);
+#if MBED_CONF_APP_ADC_DMA_BURST
+    startBurstSampling();
+#endif
+#if MBED_CONF_APP_AXES > 1
+    // All the PWM outputs share one period register, so setting it on one sets it for all.
+    toActuator1.period_us(pwmPeriodUs);
+#endif
+}
+
+float readForce (int axis) {
+#if MBED_CONF_APP_AXES > 1
+    if (axis > 0) {
+        return extraAmps[axis - 1]->read();
+    }
+#endif
+#if MBED_CONF_APP_ADC_DMA_BURST
+    return sumNewestSamples() * (1.0f / (4095 * MBED_CONF_APP_ADC_OVERSAMPLE));
+#else
+    return fromAmp;
+#endif
+}
+
+uint16_t readForceRaw (int axis) {
+#if MBED_CONF_APP_AXES > 1
+    if (axis > 0) {
+        return extraAmps[axis - 1]->read_u16();
+    }
+#endif
+#if MBED_CONF_APP_ADC_DMA_BURST
+    // Scaled so a full-scale average is 0xFFFF, same as read_u16(), but keeping the extra bits the averaging bought.
+    return (uint16_t)((uint64_t)sumNewestSamples() * 0xFFFF / (4095 * MBED_CONF_APP_ADC_OVERSAMPLE));
+#else
+    return fromAmp.read_u16();
+#endif
+}
+
+void writeActuator (int axis, float position) {
+#if MBED_CONF_APP_AXES > 1
+    if (axis > 0) {
+        extraActuators[axis - 1]->write(position);
+        return;
+    }
+#endif
+    toActuator = position;
+}
+
+void writeActuatorRaw (int axis, uint16_t position) {
+#if MBED_CONF_APP_AXES > 1
+    if (axis > 0) {
+        extraActuators[axis - 1]->write(position * (1.0f / 0xFFFF));
+        return;
+    }
+#endif
+    toActuator.write_u16(position);
+}
+
+bool readMaster () {
+    return fromMaster;
+}
+
+bool popMasterEdge (MasterEdge &edge) {
+    return masterEdges.pop(edge);
+}
+
+bool masterEdgesLost () {
+    return core_util_atomic_exchange_bool(&masterEdgeLost, false);
+}
+
+uint64_t clockMs () {
+    return Kernel::get_ms_count();
+}
+
+uint32_t clockUs () {
+    return us_ticker_read();
+}
+
+void sleepMs (uint32_t ms) {
+    ThisThread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void startTicker (uint32_t periodUs) {
+    ticksPending = 0;
+    controlTicker.attach(onControlTick, std::chrono::microseconds(periodUs));
+}
+
+uint32_t waitForTicker () {
+    // The flag can be left over from a tick that was already counted, so only the counter is trusted.
+    uint32_t elapsed;
+    while ((elapsed = core_util_atomic_exchange_u32(&ticksPending, 0)) == 0) {
+        tickFlags.wait_any(1);
+    }
+    stallRaised = false;
+    return elapsed;
+}
+
+uint32_t cycleCount () {
+    return DWT->CYCCNT;
+}
+
+uint32_t cycleCountHz () {
+    return SystemCoreClock;
+}
+
+#if MBED_CONF_APP_TELEMETRY
+static void runBackgroundTask () {
+    while (true) {
+        backgroundTask();
+        ThisThread::sleep_for(std::chrono::milliseconds(backgroundPeriodMs));
+    }
+}
+#endif
+
+void startBackgroundTask (void (*task)(), uint32_t periodMs) {
+#if MBED_CONF_APP_TELEMETRY
+    backgroundTask = task;
+    backgroundPeriodMs = periodMs;
+    backgroundThread.start(runBackgroundTask);
+#else
+    (void)task;
+    (void)periodMs;
+#endif
+}
+
+void startControlThread (void (*loop)()) {
+    controlThread.start(loop);
+}
+
+void startWatchdog (uint32_t timeoutMs, uint32_t ticks, void (*onStall)()) {
+    stallHandler = onStall;
+    stallTicks = ticks;
+    Watchdog::get_instance().start(timeoutMs);
+}
+
+void kickWatchdog () {
+    Watchdog::get_instance().kick();
+}
+
+bool resetByWatchdog () {
+    // RSID's WDTR bit. It sticks until it's written back, so it's cleared here for the next reset to set or not.
+    bool watchdog = (LPC_SC->RSID & (1 << 2)) != 0;
+    LPC_SC->RSID = 1 << 2;
+    return watchdog;
+}
+
+int threadStacks (ThreadStack *stacks, int max) {
+#if defined(MBED_STACK_STATS_ENABLED)
+    mbed_stats_stack_t stats[8];
+    int count = (int)mbed_stats_stack_get_each(stats, max < 8 ? max : 8);
+    for (int i = 0; i < count; ++i) {
+        const char *name = osThreadGetName((osThreadId_t)stats[i].thread_id);
+        stacks[i] = {name != nullptr ? name : "?", stats[i].reserved_size, stats[i].max_size};
+    }
+    return count;
+#else
+    return 0;
+#endif
+}
+
+void writeTelemetry (const uint8_t *bytes, uint32_t length) {
+#if MBED_CONF_APP_TELEMETRY
+    while (length > 0) {
+        ssize_t written = telemetrySerial.write(bytes, length);
+        if (written <= 0) {
+            return;
+        }
+        bytes += written;
+        length -= written;
+    }
+#endif
+}
+
+int readConsole () {
+    FileHandle *console = mbed_file_handle(STDIN_FILENO);
+    char c;
+    if (console != nullptr && console->readable() && console->read(&c, 1) == 1) {
+        return c;
+    }
+    return -1;
+}
+
+/*
+The calibration record lives at the start of the last flash sector (32K on the LPC1768), far past the end of the
+program. Erasing and programming stall the whole chip, interrupts and all, so this is only done after a calibration.
+*/
+static uint32_t calibrationAddress (FlashIAP &flash) {
+    uint32_t end = flash.get_flash_start() + flash.get_flash_size();
+    return end - flash.get_sector_size(end - 1);
+}
+
+bool loadCalibrationRecord (void *record, uint32_t length) {
+    FlashIAP flash;
+    if (flash.init() != 0) {
+        return false;
+    }
+    bool read = flash.read(record, calibrationAddress(flash), length) == 0;
+    flash.deinit();
+    return read;
+}
+
+bool saveCalibrationRecord (const void *record, uint32_t length) {
+    // Programming goes a whole page at a time, so the record is padded out to one.
+    static uint8_t page[256];
+    FlashIAP flash;
+    if (flash.init() != 0) {
+        return false;
+    }
+    uint32_t address = calibrationAddress(flash);
+    uint32_t pageSize = flash.get_page_size();
+    bool saved = length <= pageSize && pageSize <= sizeof(page);
+    if (saved) {
+        memset(page, flash.get_erase_value(), pageSize);
+        memcpy(page, record, length);
+        saved = flash.erase(address, flash.get_sector_size(address)) == 0 && flash.program(page, address, pageSize) == 0;
+    }
+    flash.deinit();
+    return saved;
+}
@@ -0,0 +1,120 @@
+#include "calibration.h"
+#include "board.h"
+#include "config.h"
+#include "controller.h"
+#include "looptimer.h"
+#include "motion.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+
+const uint32_t calibrationMagic {0x524F434B}; // "ROCK"
+const uint16_t calibrationVersion {2}; // Bump whenever CalibrationRecord changes.
+const float zeroTolerance {0.01}; // How far the load cell can have drifted, in readForce() units. ~3% of inRange.
+
+struct CalibrationRecord {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    // One of each per axis. The size check catches a record from a build with a different axis count.
+    float inZero[axisCount];
+    float inMin[axisCount];
+    float inMax[axisCount];
+    float outMin[axisCount];
+    float outMax[axisCount];
+    uint32_t crc; // Of everything above.
+};
+
+static uint32_t crc32 (const uint8_t *bytes, uint32_t length) {
+// Plain bitwise CRC-32. It's run once per boot, so a table isn't worth the flash.
+    uint32_t crc {0xFFFFFFFF};
+    for (uint32_t i = 0; i < length; ++i) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t recordCrc (const CalibrationRecord &record) {
+    return crc32((const uint8_t *)&record, offsetof(CalibrationRecord, crc));
+}
+
+void saveCalibration () {
+    CalibrationRecord record {};
+    record.magic = calibrationMagic;
+    record.version = calibrationVersion;
+    record.size = sizeof(CalibrationRecord);
+    for (int axis = 0; axis < axisCount; ++axis) {
+        record.inZero[axis] = axes.inZero[axis];
+        record.inMin[axis] = axes.inMin[axis];
+        record.inMax[axis] = axes.inMax[axis];
+        record.outMin[axis] = axes.outMin[axis];
+        record.outMax[axis] = axes.outMax[axis];
+    }
+    record.crc = recordCrc(record);
+    if (!saveCalibrationRecord(&record, sizeof(record))) {
+        printf("Couldn't save calibration.\n");
+    }
+}
+
+static bool loadRecord (CalibrationRecord &record) {
+    if (!loadCalibrationRecord(&record, sizeof(record))) {
+        return false;
+    }
+    if (record.magic != calibrationMagic || record.version != calibrationVersion
+            || record.size != sizeof(CalibrationRecord) || record.crc != recordCrc(record)) {
+        printf("No valid stored calibration.\n");
+        return false;
+    }
+    return true;
+}
+
+static bool restoreAxis (const CalibrationRecord &record, int axis) {
+/*
+Checks one axis of the stored calibration against a short zero measurement before using it. Any drift within
+tolerance is taken as the new zero, with inMin and inMax shifted to suit. Leaves the axis alone if it fails.
+*/
+    float zero = measureZero(axis);
+    float stored {record.inZero[axis]};
+    if (std::fabs(zero - stored) > zeroTolerance) {
+        printf("axis %d: stored calibration rejected: zero reads %f, was %f.\n", axis, zero, stored);
+        return false;
+    }
+    axes.inZero[axis] = zero;
+    axes.inMin[axis] = record.inMin[axis] + (zero - stored);
+    axes.inMax[axis] = record.inMax[axis] + (zero - stored);
+    axes.outMin[axis] = record.outMin[axis];
+    axes.outMax[axis] = record.outMax[axis];
+    move(axis, axes.outMin[axis]);
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    syncFixedFromFloat(axis);
+#endif
+    printf("axis %d: %f, %f, %f ... %f, %f (stored)\n", axis, axes.inMin[axis], axes.inZero[axis], axes.inMax[axis],
+           axes.outMin[axis], axes.outMax[axis]);
+    return true;
+}
+
+void calibrateAtStartup () {
+/*
+Every axis that checks out is restored; only the ones that don't get the full sweeps, one after another. Holding
+fromMaster high through power-up asks for a fresh calibration of all of them.
+*/
+    CalibrationRecord record {};
+    bool stored = !readMaster() && loadRecord(record);
+    if (stored) {
+        // Long enough for the power-up shaking to die down, which is the point of calibrate()'s longer settle.
+        idleFor(200);
+    }
+    bool changed {false};
+    for (int axis = 0; axis < axisCount; ++axis) {
+        if (!stored || !restoreAxis(record, axis)) {
+            calibrate(axis);
+            changed = true;
+        }
+    }
+    if (changed) {
+        saveCalibration();
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+/*
+Keeps the results of calibrate() in flash, so a power-up normally skips the sweeps. A stored calibration is only
+trusted if its checksum and version check out and the load cell still reads close to the zero it was taken at;
+otherwise, or if fromMaster is held during power-up, the full calibrate() runs and its results replace the old ones.
+Each axis is checked on its own, so one that's drifted doesn't send the others back through their sweeps.
+*/
+
+void saveCalibration ();
+void calibrateAtStartup ();
@@ -0,0 +1,123 @@
+#pragma once
+
+/*
+Build-time options. On the target these come from the "config" section of mbed_app.json (mbed turns them into
+MBED_CONF_APP_* macros); anywhere else, like the simulator, the defaults below apply.
+Keep the defaults here in step with mbed_app.json.
+*/
+
+#ifndef MBED_CONF_APP_FIXED_RATE_LOOP
+#define MBED_CONF_APP_FIXED_RATE_LOOP 1
+#endif
+
+#ifndef MBED_CONF_APP_CONTROL_PERIOD_US
+#define MBED_CONF_APP_CONTROL_PERIOD_US 1000
+#endif
+
+#ifndef MBED_CONF_APP_AXES
+#define MBED_CONF_APP_AXES 1
+#endif
+
+#ifndef MBED_CONF_APP_FIXED_POINT_CONTROLLER
+#define MBED_CONF_APP_FIXED_POINT_CONTROLLER 0
+#endif
+
+#ifndef MBED_CONF_APP_ENGINE_BENCHMARK
+#define MBED_CONF_APP_ENGINE_BENCHMARK 0
+#endif
+
+#ifndef MBED_CONF_APP_ADC_DMA_BURST
+#define MBED_CONF_APP_ADC_DMA_BURST 0
+#endif
+
+#ifndef MBED_CONF_APP_ADC_OVERSAMPLE
+#define MBED_CONF_APP_ADC_OVERSAMPLE 64
+#endif
+
+#ifndef MBED_CONF_APP_DAC_STREAMING
+#define MBED_CONF_APP_DAC_STREAMING 0
+#endif
+
+#ifndef MBED_CONF_APP_DAC_STREAM_RATE_HZ
+#define MBED_CONF_APP_DAC_STREAM_RATE_HZ 10000
+#endif
+
+#ifndef MBED_CONF_APP_DAC_STREAM_SIZE
+#define MBED_CONF_APP_DAC_STREAM_SIZE 1024
+#endif
+
+#ifndef MBED_CONF_APP_FORCE_ESTIMATOR
+#define MBED_CONF_APP_FORCE_ESTIMATOR 0
+#endif
+
+#ifndef MBED_CONF_APP_COMPLIANCE_MODE
+#define MBED_CONF_APP_COMPLIANCE_MODE 0
+#endif
+
+#ifndef MBED_CONF_APP_IDLE_SCHEDULING
+#define MBED_CONF_APP_IDLE_SCHEDULING 0
+#endif
+
+#ifndef MBED_CONF_APP_IDLE_AFTER_MS
+#define MBED_CONF_APP_IDLE_AFTER_MS 250
+#endif
+
+#ifndef MBED_CONF_APP_IDLE_DIVIDER
+#define MBED_CONF_APP_IDLE_DIVIDER 10
+#endif
+
+#ifndef MBED_CONF_APP_IDLE_WAKE_FORCE
+#define MBED_CONF_APP_IDLE_WAKE_FORCE 0.03f
+#endif
+
+#ifndef MBED_CONF_APP_FIXTURE_TABLE_SIZE
+#define MBED_CONF_APP_FIXTURE_TABLE_SIZE 128
+#endif
+
+#ifndef MBED_CONF_APP_RECORDER_TICKS
+#define MBED_CONF_APP_RECORDER_TICKS 128
+#endif
+
+#ifndef MBED_CONF_APP_RECORDER_POST_TICKS
+#define MBED_CONF_APP_RECORDER_POST_TICKS 32
+#endif
+
+#ifndef MBED_CONF_APP_RECORDER_TRIGGERS
+#define MBED_CONF_APP_RECORDER_TRIGGERS 30
+#endif
+
+#ifndef MBED_CONF_APP_CONTROL_DEADLINE_US
+#define MBED_CONF_APP_CONTROL_DEADLINE_US (MBED_CONF_APP_CONTROL_PERIOD_US / 2)
+#endif
+
+#ifndef MBED_CONF_APP_STALL_TICKS
+#define MBED_CONF_APP_STALL_TICKS 5
+#endif
+
+#ifndef MBED_CONF_APP_WATCHDOG_MS
+#define MBED_CONF_APP_WATCHDOG_MS 500
+#endif
+
+#ifndef MBED_CONF_APP_CONTROL_STACK_SIZE
+#define MBED_CONF_APP_CONTROL_STACK_SIZE 1536
+#endif
+
+#ifndef MBED_CONF_APP_BACKGROUND_STACK_SIZE
+#define MBED_CONF_APP_BACKGROUND_STACK_SIZE 768
+#endif
+
+#ifndef MBED_CONF_APP_PROFILING
+#define MBED_CONF_APP_PROFILING 0
+#endif
+
+#ifndef MBED_CONF_APP_TELEMETRY
+#define MBED_CONF_APP_TELEMETRY 0
+#endif
+
+#ifndef MBED_CONF_APP_TELEMETRY_RING_SIZE
+#define MBED_CONF_APP_TELEMETRY_RING_SIZE 128
+#endif
+
+#ifndef MBED_CONF_APP_TELEMETRY_DRAIN_MS
+#define MBED_CONF_APP_TELEMETRY_DRAIN_MS 5
+#endif
@@ -0,0 +1,425 @@
+#include "controller.h"
+#include "board.h"
+#include "config.h"
+#include "fixtures.h"
+#include "flightrecorder.h"
+#include "idlemode.h"
+#include "looptimer.h"
+#include "masterinput.h"
+#include "motion.h"
+#include "profiler.h"
+#include "trajectory.h"
+#include <cmath>
+#include <cstdio>
+
+using std::abs;
+using std::copysign;
+using std::pow;
+
+static AxisTuning defaultTuning () {
+// Every axis starts out with the tuning that was worked out for the first one.
+    AxisTuning defaults {};
+    for (int axis = 0; axis < axisCount; ++axis) {
+        defaults.slickness[axis] = FactoryTuning::slickness(axis);
+        defaults.inertia[axis] = FactoryTuning::inertia(axis);
+        defaults.predictXCyclesAhead[axis] = FactoryTuning::predictXCyclesAhead(axis);
+        defaults.inRange[axis] = 0.3;
+        defaults.maxSpeed[axis] = FactoryTuning::maxSpeed(axis);
+        defaults.maxAcceleration[axis] = FactoryTuning::maxAcceleration(axis);
+        // Takes ~20ms to get up to full acceleration, which keeps the load cell quiet.
+        defaults.maxJerk[axis] = 0.000015;
+        defaults.estimator[axis] = (ForceEstimator)MBED_CONF_APP_FORCE_ESTIMATOR;
+        defaults.compliance[axis] = (ComplianceMode)MBED_CONF_APP_COMPLIANCE_MODE;
+    }
+    return defaults;
+}
+
+static AxisState defaultState () {
+    AxisState state {};
+    for (int axis = 0; axis < axisCount; ++axis) {
+        state.outMin[axis] = 0.0;
+        state.outMax[axis] = 1.0;
+    }
+    return state;
+}
+
+AxisTuning tuning {defaultTuning()};
+AxisState axes {defaultState()};
+bool liveTuning {false};
+
+float clamp (float toClamp, float min, float max) {
+// Given a value, returns that value if it's within a given maximum / minimum.
+// Otherwise, returns the violated maximum / minimum.
+    if (toClamp > max) {
+        toClamp = max;
+    }
+    else if (toClamp < min) {
+        toClamp = min;
+    }
+    return toClamp;
+}
+
+float readInputs (int axis) {
+// Updates the 'inScaled' value, a 0-1 clamped representation of the force signal.
+    axes.inScaledPrior[axis] = axes.inScaled[axis];
+    axes.inScaled[axis] = (clamp(readForce(axis), axes.inMin[axis], axes.inMax[axis]) - axes.inZero[axis]) / tuning.inRange[axis];
+    estimateForceRate(axis);
+    return axes.inScaled[axis];
+}
+
+float specialSauce (int axis, float input) {  
+    // Just changes the number provided depending on whether or not it opposes the current velocity.  
+    float factor = 5.5 + copysign(4.5, input * axes.velocity[axis] + 0.00000001);
+    // Leaving this here for future reference. pow() can't handle negative numbers raised to non-integer powers:
+    // return copysign(pow(abs(input), factor) / factor, input);
+    return input / factor;
+}
+
+static float pointSum (int first, int last, float start, float slope) {
+// The sum of start + i * slope over i = first..last; an arithmetic series, so no need to walk it.
+    int count = last - first + 1;
+    return count * start + slope * ((float)(first + last) * count / 2);
+}
+
+template <typename Tuning>
+static float futureAUC (int axis) {
+/* AUC = "area under curve".
+It's one part the current inScaled, three parts the previous inScaled, and twenty parts articipated future inScaled values.
+Future values simply assume the current rate of change, as forceRate() has it.
+The future points are inScaled + i * slope for i = 0..predictXCyclesAhead, each put through specialSauce(). That only
+ever divides by 10 (the point agrees with velocity) or 1 (it opposes it), and which one is decided by the sign of
+point * velocity: linear in i, so it flips at most once. That leaves two arithmetic series, whatever the horizon. */
+    float inScaled = axes.inScaled[axis];
+    float velocity = axes.velocity[axis];
+    float slope = forceRate(axis);
+    int last = Tuning::predictXCyclesAhead(axis);
+    float anticipatedAUC = specialSauce(axis, axes.inScaledPrior[axis]) * 3;
+    // specialSauce()'s test, point * velocity + 0.00000001 >= 0, written as agreeAt0 + agreeSlope * i >= 0.
+    float agreeAt0 = inScaled * velocity + 0.00000001f;
+    float agreeSlope = slope * velocity;
+    int firstAgreeing {0};
+    int lastAgreeing {last};
+    if (agreeSlope == 0) {
+        if (agreeAt0 < 0) {
+            firstAgreeing = last + 1;
+        }
+    }
+    else {
+        // Compared as floats first: with a tiny slope the crossing can be far beyond what an int holds.
+        float crossing = -agreeAt0 / agreeSlope;
+        if (agreeSlope > 0) {
+            firstAgreeing = crossing > last ? last + 1 : crossing < 0 ? 0 : (int)ceilf(crossing);
+        }
+        else {
+            lastAgreeing = crossing < 0 ? -1 : crossing > last ? last : (int)floorf(crossing);
+        }
+    }
+    // The agreeing points are a prefix or a suffix of the run, so the opposing ones are whatever's left either side.
+    // Empty ranges come out as a count of zero, and so a sum of zero.
+    float agreeing = pointSum(firstAgreeing, lastAgreeing, inScaled, slope);
+    float opposing = pointSum(0, firstAgreeing - 1, inScaled, slope) + pointSum(lastAgreeing + 1, last, inScaled, slope);
+    anticipatedAUC += agreeing / 10 + opposing;
+    axes.anticipatedAUC[axis] = anticipatedAUC;
+    return anticipatedAUC;
+}
+
+float calculateFutureAUC (int axis) {
+    return futureAUC<LiveTuning>(axis);
+}
+
+template <typename Tuning>
+static void updateVelocityWith (int axis) {
+    uint32_t started = profileStart();
+    if (tuning.compliance[axis] == ComplianceMode::Mpc) {
+        axes.velocity[axis] = mpcVelocity(axis, Tuning::inertia(axis), Tuning::predictXCyclesAhead(axis),
+                                          Tuning::maxSpeed(axis), Tuning::maxAcceleration(axis));
+        profileEnd(ProfileStage::Update, started);
+        return;
+    }
+    futureAUC<Tuning>(axis);
+    profileEnd(ProfileStage::Predict, started);
+    started = profileStart();
+    float velocity = axes.velocity[axis];
+    // predictXCyclesAhead^2 is the theoretical maximum AUC. Both divisions are by tuning, so they're done as one
+    // multiply: by a constant, with FactoryTuning.
+    int horizon = Tuning::predictXCyclesAhead(axis);
+    float scale = 1 / ((float)horizon * horizon * Tuning::inertia(axis));
+    float maxAcceleration = Tuning::maxAcceleration(axis);
+    float maxSpeed = Tuning::maxSpeed(axis);
+    // Velocity is a component here because if friction (slickness) acts proportionally to speed, force should too.
+    float deltaV = clamp(axes.anticipatedAUC[axis] * scale * (abs(velocity) + 0.007f), -maxAcceleration, maxAcceleration);
+    // if (clockMs() % 200 == 0) {
+    //     printf("%f, %f, %f, %f, %f \n", inScaledPrior, inScaled, velocity, anticipatedAUC, rawDeltaV);
+    // }
+    float provisionalVelocity = clamp(velocity * Tuning::slickness(axis) + deltaV, -maxSpeed, maxSpeed);
+    axes.velocity[axis] = provisionalVelocity;
+    profileEnd(ProfileStage::Update, started);
+}
+
+void updateVelocity (int axis) {
+// The prescriptive half of comply(): works the force into velocity without moving anything. The move engine uses it
+// on its own for moves that are partly compliant.
+    if (liveTuning) {
+        updateVelocityWith<LiveTuning>(axis);
+    }
+    else {
+        updateVelocityWith<FactoryTuning>(axis);
+    }
+}
+
+static void output (int axis) {
+// The descriptive half of comply(): carries the command on by velocity and writes it out.
+    uint32_t started = profileStart();
+    float command = clamp(axes.command[axis] + axes.velocity[axis], axes.outMin[axis], axes.outMax[axis]);
+    axes.command[axis] = command;
+    writeActuator(axis, command);
+    profileEnd(ProfileStage::Output, started);
+    // If the actuator could have velocity-debt while stuck on the end if its range, that would be bad:
+    if (command >= axes.outMax[axis] || command <= axes.outMin[axis]) {
+        if (abs(axes.velocity[axis]) > limitHitSpeed * tuning.maxSpeed[axis]) {
+            triggerFlightRecorder(RecorderTrigger::LimitHit, axis);
+        }
+        axes.velocity[axis] = 0;
+    }
+}
+
+void comply (int axis) {
+/* This is the important part: where the (imaginary/prescriptive) velocity is calculated, and the actuator is commanded.
+This function is the only content of the main loop, as long as it's not executing a move command.
+If you want to change how the actuator floats, it's probably going to be done here (or in updateVelocity()). */
+    updateVelocity(axis);
+    output(axis);
+}
+
+void coast (int axis) {
+// comply() for when there's no force to speak of: friction's all that acts, so there's nothing to predict.
+    axes.velocity[axis] *= liveTuning ? LiveTuning::slickness(axis) : FactoryTuning::slickness(axis);
+    output(axis);
+}
+
+void insertForce (int axis, float force) {
+// Adding force to the inScaled value artificially causes comply() to push/pull with that much force.
+    axes.inScaled[axis] = clamp(axes.inScaled[axis] + force, -1.0, 1.0);
+}
+
+float measureZero (int axis) {
+// The load cell's reading with nothing on it, averaged over a few dozen ticks so the noise doesn't end up in inZero.
+    const int samples {64};
+    float sum {0};
+    for (int i = 0; i < samples; ++i) {
+        sum += readForce(axis);
+        waitForControlTick();
+    }
+    return sum / samples;
+}
+
+static bool approachContact (int axis, const MotionLimits &limits) {
+/*
+Like move(axis, 1.0, limits), but it stops as soon as the force starts climbing, not once it's over the 0.15
+threshold. That's judged on the trend as well as the level, so it can run a lot faster than the creep and still stop
+before it's leaning on anything. Returns true if it stopped for contact, false if it got all the way to 1.0.
+*/
+    const float warning {0.05};
+    const float lookahead {8}; // Ticks.
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    publishFixedState(axis);
+#endif
+    axes.velocity[axis] = 0.0;
+    Trajectory plan = planTrajectory(axes.command[axis], 1.0, limits);
+    uint32_t startUs = clockUs();
+    // Both smoothed over a few ticks: single readings, and especially the differences between them, are mostly
+    // noise until something is actually touched.
+    float level = abs(readInputs(axis));
+    float rise {0};
+    bool contact {false};
+    while (true) {
+        float levelPrior = level;
+        level += (abs(readInputs(axis)) - level) / 4;
+        rise += (level - levelPrior - rise) / 4;
+        if (level > warning || level + rise * lookahead > 0.15) {
+            contact = true;
+            break;
+        }
+        float tick = (float)(clockUs() - startUs) / loopTiming.periodUs;
+        axes.command[axis] = trajectoryPosition(plan, tick);
+        writeActuator(axis, axes.command[axis]);
+        if (tick >= plan.duration) {
+            break;
+        }
+        waitForControlTick();
+    }
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    syncFixedFromFloat(axis);
+#endif
+    return contact;
+}
+
+static float seekLimit (int axis) {
+/*
+Finds where the hand is, going toward 1.0: quickly until contact is first sensed, then back off a little and creep
+back in, stopping when inScaled passes 0.15 the same as ever. Returns where it stopped.
+*/
+    const MotionLimits approach {0.001, 0.00005, 0.000005}; // Full range in about a second.
+    // Barely moving when it meets the hand, but it only ever has a few centimetres to go.
+    const MotionLimits creep {0.0002, 0.00001, 0.000002};
+    const float backOff {0.03};
+    while (axes.command[axis] < 1.0 && approachContact(axis, approach)) {
+        move(axis, clamp(axes.command[axis] - backOff, 0.0, 1.0), approach, false);
+        // Let the hand and the load cell settle after the bump.
+        idleFor(100);
+        if (!move(axis, clamp(axes.command[axis] + 3 * backOff, 0.0, 1.0), creep)) {
+            break;
+        }
+        // It got through without meeting anything, so that was a false alarm (or the hand moved). Speed back up.
+    }
+    return axes.command[axis];
+}
+
+static void waitForRelease (int axis, uint32_t timeoutMs) {
+// Waits (up to a point) for the hand to stop pressing, which is how the user says they've moved it.
+    const float released {0.1};
+    const uint32_t steadyTicks = 100000 / loopTiming.periodUs; // 100ms
+    uint32_t timeoutTicks = (uint32_t)((uint64_t)timeoutMs * 1000 / loopTiming.periodUs);
+    uint32_t quietTicks {0};
+    for (uint32_t tick = 0; tick < timeoutTicks; ++tick) {
+        quietTicks = abs(readInputs(axis)) < released ? quietTicks + 1 : 0;
+        if (quietTicks >= steadyTicks) {
+            return;
+        }
+        waitForControlTick();
+    }
+}
+
+void calibrate (int axis) {
+/*
+Finds one axis's zero and working range. The other axes are left where they are (and not complying) meanwhile, so
+calibrating several means doing it one axis at a time, hand and all.
+*/
+    // Moves stay inside outMin..outMax, and the old range is what's being replaced, so the sweeps get all of it.
+    axes.outMin[axis] = 0.0;
+    axes.outMax[axis] = 1.0;
+    // Only does anything when recalibrating while running: the sweeps start from the minimum position.
+    move(axis, 0.0, false);
+    // This initial delay is to let any physical shaking work itself out before an initial measurement is taken.
+    idleFor(1500);
+    axes.inZero[axis] = measureZero(axis);
+    axes.inMax[axis] = axes.inZero[axis] + tuning.inRange[axis];
+    axes.inMin[axis] = axes.inZero[axis] - tuning.inRange[axis];
+    // Starting from the minimum position, moves the actuator downward until some significant resistance is detected.
+    // The current positions becomes the top of the working range.
+    // The intention is for a user to use place their hand where they want the limit to be.
+    axes.outMin[axis] = seekLimit(axis);
+    // printf("outMin = %f\n", outMin);
+    // Then, once they've moved their hand, repeat to get the bottom of the range.
+    waitForRelease(axis, 2000);
+    axes.outMax[axis] = seekLimit(axis);
+    // printf("outMax = %f\n", outMax);
+    // Away from the hand, so there's no need to yield to it.
+    move(axis, axes.outMin[axis], false);
+    printf("axis %d: %f, %f, %f ... %f, %f\n", axis, axes.inMin[axis], axes.inZero[axis], axes.inMax[axis],
+           axes.outMin[axis], axes.outMax[axis]);
+    if (axes.outMax[axis] - axes.outMin[axis] < minimumStroke) {
+        triggerFlightRecorder(RecorderTrigger::OddLimits, axis);
+    }
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    syncFixedFromFloat(axis);
+#endif
+}
+
+void controlStep () {
+// One tick of the main loop, every axis in turn. Pacing is left to the caller.
+    uint32_t cycles = cycleCount();
+    uint32_t tickStarted = profileStart();
+    MasterTick master = drainMasterInput();
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    q30 masterForce = -(q30)(master.duty * (q30One / 2));
+#endif
+    for (int axis = 0; axis < axisCount; ++axis) {
+        uint32_t axisStarted = profileStart();
+        bool wasMoving = movePending(axis);
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+        if (movePending(axis)) {
+            // Moves run in floats; see move().
+            publishFixedState(axis);
+            readInputs(axis);
+            bool moved = stepMove(axis, master.rose);
+            syncFixedFromFloat(axis);
+            if (!moved) {
+                controlStepFixed(axis, masterForce);
+            }
+            else {
+                keepAwake(axis);
+            }
+        }
+        else {
+            controlStepFixed(axis, masterForce);
+        }
+#else
+        uint32_t started = profileStart();
+        readInputs(axis);
+        profileEnd(ProfileStage::Read, started);
+        // A move, if there is one, has the actuator this tick. If it just ended, comply() picks up in the same tick.
+        if (!stepMove(axis, master.rose)) {
+            // The same push as always while fromMaster is held, pro rata for however much of the last tick it was.
+            if (master.duty > 0) {
+                insertForce(axis, -0.5 * master.duty);
+            }
+            float fixture = fixtureForce(axis);
+            if (fixture != 0) {
+                insertForce(axis, fixture);
+            }
+            // Left alone, it only needs the whole of comply() every so often; see idlemode.h.
+            if (complyDue(axis, abs(axes.inScaled[axis]) < idleWakeForce)) {
+                comply(axis);
+            }
+            else {
+                coast(axis);
+            }
+        }
+        else {
+            keepAwake(axis);
+        }
+#endif
+        if (wasMoving && !movePending(axis) && lastMoveEnd(axis) == MoveEnd::Resisted) {
+            triggerFlightRecorder(RecorderTrigger::MoveResisted, axis);
+        }
+        profileAxis(axis, axisStarted);
+    }
+    masterActuated();
+    buildFixtures();
+    profileEnd(ProfileStage::Tick, tickStarted);
+    recordTickCost(cycleCount() - cycles);
+}
+
+void compareTuningCost () {
+/*
+Times updateVelocity() on FactoryTuning against LiveTuning, the same way compareEngineCost() times the engines. The
+two instantiations' code sizes are in the linker map (or nm --size-sort -C on the .elf), as updateVelocityWith<>.
+Only the first axis is timed.
+*/
+    const int runs {256};
+    const int axis {0};
+    float savedVelocity = axes.velocity[axis];
+    float savedInScaled = axes.inScaled[axis];
+    float savedPrior = axes.inScaledPrior[axis];
+    uint32_t factoryCycles {0};
+    uint32_t liveCycles {0};
+    for (int i = 0; i < runs; ++i) {
+        float velocity = (i % 3 - 1) * tuning.maxSpeed[axis] / 2;
+        axes.inScaledPrior[axis] = (i % 17 - 8) / 40.0f;
+        axes.inScaled[axis] = axes.inScaledPrior[axis] + (i % 5 - 2) / 200.0f;
+        axes.velocity[axis] = velocity;
+        uint32_t start = cycleCount();
+        updateVelocityWith<FactoryTuning>(axis);
+        factoryCycles += cycleCount() - start;
+        axes.velocity[axis] = velocity;
+        start = cycleCount();
+        updateVelocityWith<LiveTuning>(axis);
+        liveCycles += cycleCount() - start;
+    }
+    axes.velocity[axis] = savedVelocity;
+    axes.inScaled[axis] = savedInScaled;
+    axes.inScaledPrior[axis] = savedPrior;
+    printf("updateVelocity(): %lu cycles on FactoryTuning, %lu on LiveTuning (mean of %d)\n",
+           (unsigned long)(factoryCycles / runs), (unsigned long)(liveCycles / runs), runs);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "config.h"
+#include "estimator.h"
+#include "fixedpoint.h"
+#include "mpc.h"
+#include <cstdint>
+
+/*
+The compliance controller itself. Nothing in here knows whether it's running on the LPC1768 or in the
+simulator; all I/O and timing goes through board.h.
+It drives axisCount actuators, each with its own load cell, tuning and state. Those are kept as structure-of-arrays
+(one array per value, indexed by axis), and every function takes the axis it works on; one controlStep() services
+them all.
+*/
+
+const int axisCount {MBED_CONF_APP_AXES};
+
+struct AxisTuning {
+    float slickness[axisCount]; // An inverted friction value: determines how quickly the actuator stops when no forces are applied
+    float inertia[axisCount]; // Determines how reluctantly the actuator accelerates. No real limits to this value.
+    int predictXCyclesAhead[axisCount]; // Controls the relative strength of the 'derivative' portion of the comply() algorithm.
+    float inRange[axisCount]; // IMPORTANT: this is based on the known range of input voltages. If the voltage range changes, this should change.
+    float maxSpeed[axisCount];
+    float maxAcceleration[axisCount];
+    float maxJerk[axisCount]; // Only used by moves.
+    ForceEstimator estimator[axisCount]; // Where calculateFutureAUC()'s slope comes from; see estimator.h.
+    ComplianceMode compliance[axisCount]; // What updateVelocity() runs: the predictor, or the MPC in mpc.h.
+};
+
+struct AxisState {
+    float inZero[axisCount]; // Based on value at startup
+    float inMax[axisCount];
+    float inMin[axisCount];
+    float inScaled[axisCount];
+    float inScaledPrior[axisCount];
+    float outMin[axisCount];
+    float outMax[axisCount];
+    float velocity[axisCount];
+    float command[axisCount]; // Allows us more precision in our calculations than the DAC allows. Actually does matter.
+    float anticipatedAUC[axisCount]; // AUC = Area Under Curve
+};
+
+extern AxisTuning tuning;
+extern AxisState axes;
+
+/*
+Where comply() gets its tuning from. FactoryTuning has the values as compile-time constants, so everything comply()
+works out from them (the 1 / (predictXCyclesAhead^2 * inertia) scale, the horizon's arithmetic series) folds away;
+it's what runs normally. LiveTuning reads the tuning globals every tick, for tuning sessions: set liveTuning and any
+change to them takes effect on the next tick. The globals start out with FactoryTuning's values.
+*/
+struct FactoryTuning {
+    static constexpr float slickness (int) { return 0.999f; }
+    static constexpr float inertia (int) { return 0.75f; }
+    static constexpr int predictXCyclesAhead (int) { return 20; }
+    static constexpr float maxSpeed (int) { return 0.0055f; } // Per datasheet: max speed 33 inches per second.
+    // Can fully actuate in ~300ms. Note, though, that it's accelerating for the first and last ~100ms.
+    // IMPORTANT: acceleration is also proportional to this!
+    static constexpr float maxAcceleration (int) { return 0.0003f; }
+};
+
+struct LiveTuning {
+    static float slickness (int axis) { return tuning.slickness[axis]; }
+    static float inertia (int axis) { return tuning.inertia[axis]; }
+    static int predictXCyclesAhead (int axis) { return tuning.predictXCyclesAhead[axis]; }
+    static float maxSpeed (int axis) { return tuning.maxSpeed[axis]; }
+    static float maxAcceleration (int axis) { return tuning.maxAcceleration[axis]; }
+};
+
+extern bool liveTuning;
+
+float clamp (float toClamp, float min, float max);
+float readInputs (int axis);
+float specialSauce (int axis, float input);
+float calculateFutureAUC (int axis); // Always on LiveTuning.
+void updateVelocity (int axis);
+void comply (int axis);
+void coast (int axis);
+void insertForce (int axis, float force);
+float measureZero (int axis);
+void calibrate (int axis);
+void controlStep ();
+void compareTuningCost ();
+
+// The fixed-point engine in controller_fixed.cpp, selected with fixed-point-controller in mbed_app.json.
+void syncFixedFromFloat (int axis);
+void publishFixedState (int axis);
+bool fixedStateCurrent (int axis); // The fixed-point engine has had the axis since the last syncFixedFromFloat().
+q30 readInputsFixed (int axis);
+int64_t calculateFutureAUCFixed (int axis);
+void complyFixed (int axis);
+void coastFixed (int axis);
+void insertForceFixed (int axis, q30 force);
+void controlStepFixed (int axis, q30 masterForce); // masterForce goes through insertForceFixed() first.
+void compareEngineCost ();
@@ -0,0 +1,237 @@
+#include "controller.h"
+#include "board.h"
+#include "fixedpoint.h"
+#include "flightrecorder.h"
+#include "idlemode.h"
+#include "profiler.h"
+#include <cmath>
+#include <cstdio>
+
+/*
+The same algorithm as readInputs()/calculateFutureAUC()/comply() in controller.cpp, in Q2.30 integer math.
+The LPC1768 has no FPU, so every float operation over there is a library call; in here the per-tick work is
+a handful of 32x32->64 multiplies, and everything that needed a divide is a reciprocal worked out ahead of time
+by syncFixedFromFloat().
+The float state (axes.inScaled, velocity, command...) is NOT kept up to date while this engine runs. Call
+publishFixedState() before anything reads an axis's, and syncFixedFromFloat() after anything writes it.
+*/
+
+// One array per value, indexed by axis, the same as AxisState.
+struct FixedAxes {
+    q30 inZero[axisCount];
+    q30 inMin[axisCount];
+    q30 inMax[axisCount];
+    int64_t inRangeReciprocal[axisCount];
+    q30 inScaled[axisCount];
+    q30 inScaledPrior[axisCount];
+    q30 velocity[axisCount];
+    q30 command[axisCount];
+    q30 outMin[axisCount];
+    q30 outMax[axisCount];
+    q30 slickness[axisCount];
+    q30 maxSpeed[axisCount];
+    q30 maxAccelerationTimesInertia[axisCount]; // deltaV's clamp, moved to the other side of the divide by inertia.
+    int64_t inertiaReciprocal[axisCount];
+    q30 horizonSquaredReciprocal[axisCount];
+    int64_t anticipatedAUC[axisCount];
+};
+
+static FixedAxes fixed {};
+static bool current[axisCount] {};
+static const q30 qTenth {107374182}; // 0.1
+static const q30 qVelocityFloor {7516193}; // 0.007
+static const int64_t qSignBias {11529215046}; // 0.00000001, as a product of two Q30s (so Q60).
+static const q30 qIdleWakeForce {(q30)toQ30(idleWakeForce)};
+
+void syncFixedFromFloat (int axis) {
+    fixed.inZero[axis] = toQ30(axes.inZero[axis]);
+    fixed.inMin[axis] = toQ30(axes.inMin[axis]);
+    fixed.inMax[axis] = toQ30(axes.inMax[axis]);
+    fixed.inRangeReciprocal[axis] = toQ30(1 / tuning.inRange[axis]);
+    fixed.inScaled[axis] = toQ30(axes.inScaled[axis]);
+    fixed.inScaledPrior[axis] = toQ30(axes.inScaledPrior[axis]);
+    fixed.velocity[axis] = toQ30(axes.velocity[axis]);
+    fixed.command[axis] = toQ30(axes.command[axis]);
+    fixed.outMin[axis] = toQ30(axes.outMin[axis]);
+    fixed.outMax[axis] = toQ30(axes.outMax[axis]);
+    fixed.slickness[axis] = toQ30(tuning.slickness[axis]);
+    fixed.maxSpeed[axis] = toQ30(tuning.maxSpeed[axis]);
+    fixed.maxAccelerationTimesInertia[axis] = toQ30(tuning.maxAcceleration[axis] * tuning.inertia[axis]);
+    fixed.inertiaReciprocal[axis] = toQ30(1 / tuning.inertia[axis]);
+    fixed.horizonSquaredReciprocal[axis] = toQ30(1 / powf(tuning.predictXCyclesAhead[axis], 2));
+    current[axis] = false;
+}
+
+bool fixedStateCurrent (int axis) {
+    return current[axis];
+}
+
+void publishFixedState (int axis) {
+    axes.inScaled[axis] = fromQ30(fixed.inScaled[axis]);
+    axes.inScaledPrior[axis] = fromQ30(fixed.inScaledPrior[axis]);
+    axes.velocity[axis] = fromQ30(fixed.velocity[axis]);
+    axes.command[axis] = fromQ30(fixed.command[axis]);
+    axes.anticipatedAUC[axis] = fromQ30(fixed.anticipatedAUC[axis]);
+}
+
+static q30 scaleInput (int axis, uint16_t raw) {
+    // raw / 65535 in Q30 is raw * 16384.25: the shift does the 16384, the second term the quarter.
+    q30 reading = ((q30)raw << 14) + (raw >> 2);
+    return (q30)mulQ30(clampQ30(reading, fixed.inMin[axis], fixed.inMax[axis]) - fixed.inZero[axis],
+                       fixed.inRangeReciprocal[axis]);
+}
+
+q30 readInputsFixed (int axis) {
+    fixed.inScaledPrior[axis] = fixed.inScaled[axis];
+    fixed.inScaled[axis] = scaleInput(axis, readForceRaw(axis));
+    return fixed.inScaled[axis];
+}
+
+static int64_t pointSumFixed (int first, int last, q30 start, q30 slope) {
+// Same series as pointSum() in controller.cpp. (first + last) * count is always even, so the halving is exact.
+    int count = last - first + 1;
+    return (int64_t)count * start + (int64_t)slope * ((first + last) * count / 2);
+}
+
+int64_t calculateFutureAUCFixed (int axis) {
+    q30 inScaled = fixed.inScaled[axis];
+    q30 inScaledPrior = fixed.inScaledPrior[axis];
+    q30 velocity = fixed.velocity[axis];
+    q30 slope = inScaled - inScaledPrior;
+    int last = tuning.predictXCyclesAhead[axis];
+    // specialSauce(inScaledPrior) * 3
+    int64_t prior3 = (int64_t)inScaledPrior * 3;
+    if ((int64_t)inScaledPrior * velocity + qSignBias >= 0) {
+        prior3 = mulQ30(prior3, qTenth);
+    }
+    // See calculateFutureAUC() for the why; the crossing is worked out with an integer divide instead of a float one.
+    int64_t agreeAt0 = (int64_t)inScaled * velocity + qSignBias;
+    int64_t agreeSlope = (int64_t)slope * velocity;
+    int firstAgreeing {0};
+    int lastAgreeing {last};
+    if (agreeSlope == 0) {
+        if (agreeAt0 < 0) {
+            firstAgreeing = last + 1;
+        }
+    }
+    else if (agreeSlope > 0) {
+        // First i where agreeAt0 + agreeSlope * i >= 0: ceil(-agreeAt0 / agreeSlope), when that's positive.
+        if (agreeAt0 < 0) {
+            int64_t whole = -agreeAt0 / agreeSlope;
+            int64_t crossing = whole + (whole * agreeSlope != -agreeAt0);
+            firstAgreeing = crossing > last ? last + 1 : (int)crossing;
+        }
+    }
+    else {
+        // Last i where it's still >= 0: floor(agreeAt0 / -agreeSlope).
+        if (agreeAt0 < 0) {
+            lastAgreeing = -1;
+        }
+        else {
+            int64_t crossing = agreeAt0 / -agreeSlope;
+            lastAgreeing = crossing > last ? last : (int)crossing;
+        }
+    }
+    int64_t agreeing = pointSumFixed(firstAgreeing, lastAgreeing, inScaled, slope);
+    int64_t opposing = pointSumFixed(0, firstAgreeing - 1, inScaled, slope) + pointSumFixed(lastAgreeing + 1, last, inScaled, slope);
+    fixed.anticipatedAUC[axis] = prior3 + mulWideQ30(agreeing, qTenth) + opposing;
+    return fixed.anticipatedAUC[axis];
+}
+
+static void outputFixed (int axis, q30 velocity) {
+    uint32_t started = profileStart();
+    q30 command = (q30)clampQ30((int64_t)fixed.command[axis] + velocity, fixed.outMin[axis], fixed.outMax[axis]);
+    fixed.command[axis] = command;
+    q30 dac = command >> 14;
+    writeActuatorRaw(axis, dac > 0xFFFF ? 0xFFFF : dac < 0 ? 0 : (uint16_t)dac);
+    profileEnd(ProfileStage::Output, started);
+    if (command >= fixed.outMax[axis] || command <= fixed.outMin[axis]) {
+        // limitHitSpeed (a quarter) of maxSpeed, as a shift.
+        if (velocity > fixed.maxSpeed[axis] >> 2 || velocity < -(fixed.maxSpeed[axis] >> 2)) {
+            triggerFlightRecorder(RecorderTrigger::LimitHit, axis);
+        }
+        velocity = 0;
+    }
+    fixed.velocity[axis] = velocity;
+}
+
+void complyFixed (int axis) {
+    uint32_t started = profileStart();
+    calculateFutureAUCFixed(axis);
+    profileEnd(ProfileStage::Predict, started);
+    started = profileStart();
+    int64_t rawDeltaV = mulWideQ30(fixed.anticipatedAUC[axis], fixed.horizonSquaredReciprocal[axis]);
+    q30 velocity = fixed.velocity[axis];
+    q30 speed = velocity < 0 ? -velocity : velocity;
+    // Clamping before the multiply by 1/inertia (rather than after) keeps the product inside 64 bits.
+    q30 pushLimit = fixed.maxAccelerationTimesInertia[axis];
+    int64_t push = clampQ30(mulQ30(rawDeltaV, speed + qVelocityFloor), -pushLimit, pushLimit);
+    int64_t deltaV = mulQ30(push, fixed.inertiaReciprocal[axis]);
+    velocity = (q30)clampQ30(mulQ30(velocity, fixed.slickness[axis]) + deltaV, -fixed.maxSpeed[axis], fixed.maxSpeed[axis]);
+    profileEnd(ProfileStage::Update, started);
+    outputFixed(axis, velocity);
+}
+
+void coastFixed (int axis) {
+// coast(), in Q30: only friction acts.
+    outputFixed(axis, (q30)mulQ30(fixed.velocity[axis], fixed.slickness[axis]));
+}
+
+void insertForceFixed (int axis, q30 force) {
+    fixed.inScaled[axis] = (q30)clampQ30((int64_t)fixed.inScaled[axis] + force, -q30One, q30One);
+}
+
+void controlStepFixed (int axis, q30 masterForce) {
+    current[axis] = true;
+    uint32_t started = profileStart();
+    readInputsFixed(axis);
+    profileEnd(ProfileStage::Read, started);
+    if (masterForce != 0) {
+        insertForceFixed(axis, masterForce);
+    }
+    q30 force = fixed.inScaled[axis];
+    if (complyDue(axis, force < qIdleWakeForce && force > -qIdleWakeForce)) {
+        complyFixed(axis);
+    }
+    else {
+        coastFixed(axis);
+    }
+}
+
+void compareEngineCost () {
+/*
+Times comply() against complyFixed() with cycleCount(), on a spread of inputs that exercises both sides of
+specialSauce(). Each call starts from the same state, so the actuator only ever twitches by one tick's worth of
+motion. On the simulator cycleCount() is host nanoseconds, so only the ratio means much there.
+Only the first axis is timed; the others run the same code.
+*/
+    const int runs {256};
+    const int axis {0};
+    float savedVelocity = axes.velocity[axis];
+    float savedCommand = axes.command[axis];
+    float savedInScaled = axes.inScaled[axis];
+    float savedPrior = axes.inScaledPrior[axis];
+    uint32_t floatCycles {0};
+    uint32_t fixedCycles {0};
+    for (int i = 0; i < runs; ++i) {
+        axes.velocity[axis] = (i % 3 - 1) * tuning.maxSpeed[axis] / 2;
+        axes.command[axis] = savedCommand;
+        axes.inScaledPrior[axis] = (i % 17 - 8) / 40.0f;
+        axes.inScaled[axis] = axes.inScaledPrior[axis] + (i % 5 - 2) / 200.0f;
+        syncFixedFromFloat(axis);
+        uint32_t start = cycleCount();
+        comply(axis);
+        floatCycles += cycleCount() - start;
+        start = cycleCount();
+        complyFixed(axis);
+        fixedCycles += cycleCount() - start;
+    }
+    axes.velocity[axis] = savedVelocity;
+    axes.command[axis] = savedCommand;
+    axes.inScaled[axis] = savedInScaled;
+    axes.inScaledPrior[axis] = savedPrior;
+    writeActuator(axis, axes.command[axis]);
+    syncFixedFromFloat(axis);
+    printf("comply(): %lu cycles, complyFixed(): %lu cycles (mean of %d)\n", (unsigned long)(floatCycles / runs),
+           (unsigned long)(fixedCycles / runs), runs);
+}
@@ -0,0 +1,71 @@
+#include "estimator.h"
+#include "controller.h"
+
+const int sgWindow {5};
+// Benedict-Bordner gains: beta = alpha^2 / (2 - alpha) is the least lag for a given amount of smoothing when the force
+// changes as a ramp. alpha 0.4 brings the rate noise down by about the same as the five-point fit does.
+const float alpha {0.4f};
+const float beta {alpha * alpha / (2 - alpha)};
+
+struct EstimatorAxes {
+    float history[axisCount][sgWindow];
+    int newest[axisCount];
+    float level[axisCount]; // The alpha-beta filter's own idea of inScaled, which is only used to work out the rate.
+    float rate[axisCount];
+};
+
+static EstimatorAxes estimators {};
+
+void estimateForceRate (int axis) {
+    float reading = axes.inScaled[axis];
+    switch (tuning.estimator[axis]) {
+        case ForceEstimator::TwoSample:
+            // Worked out when it's asked for, so anything that sets inScaled directly (sweeps, checks) still works.
+            break;
+        case ForceEstimator::AlphaBeta: {
+            float predicted = estimators.level[axis] + estimators.rate[axis];
+            float residual = reading - predicted;
+            estimators.level[axis] = predicted + alpha * residual;
+            estimators.rate[axis] += beta * residual;
+            break;
+        }
+        case ForceEstimator::SavitzkyGolay: {
+            // Slope of the line through the last five readings, x = -2..2: weights -2, -1, 0, 1, 2 over 10.
+            int newest = (estimators.newest[axis] + 1) % sgWindow;
+            estimators.newest[axis] = newest;
+            float *history = estimators.history[axis];
+            history[newest] = reading;
+            float sum {0};
+            for (int i = 0; i < sgWindow; ++i) {
+                sum += (2 - i) * history[(newest - i + sgWindow) % sgWindow];
+            }
+            estimators.rate[axis] = sum * 0.1f;
+            break;
+        }
+    }
+}
+
+float forceRate (int axis) {
+    if (tuning.estimator[axis] == ForceEstimator::TwoSample) {
+        return axes.inScaled[axis] - axes.inScaledPrior[axis];
+    }
+    return estimators.rate[axis];
+}
+
+void resetForceEstimator (int axis) {
+// Starts over from inScaled as it is now, with the force taken to be steady.
+    for (int i = 0; i < sgWindow; ++i) {
+        estimators.history[axis][i] = axes.inScaled[axis];
+    }
+    estimators.level[axis] = axes.inScaled[axis];
+    estimators.rate[axis] = 0;
+}
+
+const char *estimatorName (ForceEstimator estimator) {
+    switch (estimator) {
+        case ForceEstimator::TwoSample: return "two-sample";
+        case ForceEstimator::AlphaBeta: return "alpha-beta";
+        case ForceEstimator::SavitzkyGolay: return "savitzky-golay";
+    }
+    return "?";
+}
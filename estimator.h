@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+Estimates how fast the force is changing, for calculateFutureAUC() to extrapolate with. The original two-sample
+difference responds quickest and is the noisiest: two readings' worth of ADC noise every tick, which the predictor
+then multiplies by anything up to predictXCyclesAhead. The others give up a little lag for a lot less noise. The
+simulator's --compare-estimators measures both for each one: phase lag against a sine, and what the noise does to
+the actuator.
+Only the rate is estimated. The force itself goes into the prediction as read, since smoothing it would put lag on
+the term that matters most.
+*/
+
+enum class ForceEstimator : uint8_t {
+    TwoSample,     // inScaled - inScaledPrior, as it always was.
+    AlphaBeta,     // Steady-state alpha-beta filter (a constant-velocity Kalman filter with its gains fixed).
+    SavitzkyGolay, // Least-squares slope through the last five readings.
+};
+
+void estimateForceRate (int axis); // Once per tick, once inScaled is up to date; readInputs() does it.
+float forceRate (int axis); // Per tick, in inScaled units.
+void resetForceEstimator (int axis);
+const char *estimatorName (ForceEstimator estimator);
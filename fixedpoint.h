@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+Q2.30 fixed point: an int32_t holding value * 2^30, so -2 to just under 2, in steps of about 1e-9.
+That's enough headroom for inScaled (-1 to 1) and command (0 to 1, inclusive, which Q1.31 can't do) and enough
+resolution for maxAcceleration and slickness to still mean something.
+Intermediate products and sums are carried in int64_t; it's up to the caller to keep those from overflowing.
+The float conversions are for setup and reporting, not for the control loop.
+*/
+
+typedef int32_t q30;
+
+const int q30Shift {30};
+const int64_t q30One {int64_t(1) << q30Shift};
+
+inline int64_t toQ30 (float value) {
+    return (int64_t)(value * (float)q30One + (value < 0 ? -0.5f : 0.5f));
+}
+
+inline float fromQ30 (int64_t value) {
+    return (float)value * (1.0f / (float)q30One);
+}
+
+inline int64_t mulQ30 (int64_t a, int64_t b) {
+// For when |a * b| fits in 63 bits.
+    return (a * b) >> q30Shift;
+}
+
+inline int64_t mulWideQ30 (int64_t a, q30 b) {
+// For when it doesn't: a is split so no partial product gets past 63 bits. Two long multiplies on the M3.
+    int64_t high = a >> 32;
+    uint32_t low = (uint32_t)a;
+    return high * b * 4 + (((int64_t)low * b) >> q30Shift);
+}
+
+inline int64_t clampQ30 (int64_t toClamp, int64_t min, int64_t max) {
+    if (toClamp > max) {
+        toClamp = max;
+    }
+    else if (toClamp < min) {
+        toClamp = min;
+    }
+    return toClamp;
+}
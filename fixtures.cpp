@@ -0,0 +1,118 @@
+#include "fixtures.h"
+#include "controller.h"
+#include <algorithm>
+#include <cmath>
+
+struct FixtureTable {
+    bool loaded; // So an axis with nothing loaded doesn't pay even for the lookup.
+    float force[fixtureTableSize + 1]; // At command i / fixtureTableSize.
+    float damping[fixtureTableSize + 1]; // Force per unit of velocity (per tick).
+};
+
+struct FixtureBuild {
+    Fixture fixtures[fixtureLimit];
+    int count;
+    bool building;
+    int nextEntry;
+};
+
+static const int fixtureBuildChunk {16}; // Table entries a tick, so nine ticks for the default 128 intervals.
+static const float pi {3.14159265f};
+static FixtureTable tables[axisCount][2];
+static uint8_t live[axisCount]; // Which of the axis's tables the ticks read.
+static FixtureBuild builds[axisCount];
+
+static void contribute (int axis, const Fixture &fixture, float position, float &force, float &damping) {
+// What one fixture adds at one point of the table.
+    if (position < fixture.from || position > fixture.to) {
+        return;
+    }
+    switch (fixture.kind) {
+        case FixtureKind::Spring:
+            force -= fixture.strength * (position - fixture.at);
+            break;
+        case FixtureKind::Wall: {
+            float fromBelow = position - fixture.from;
+            float fromAbove = fixture.to - position;
+            bool outDown = fixture.to >= 1 || (fixture.from > 0 && fromBelow < fromAbove);
+            force += outDown ? -fixture.strength * fromBelow : fixture.strength * fromAbove;
+            break;
+        }
+        case FixtureKind::Detent: {
+            float center = (fixture.from + fixture.to) / 2;
+            float halfWidth = (fixture.to - fixture.from) / 2;
+            if (halfWidth > 0) {
+                force -= fixture.strength * sinf(pi * (position - center) / halfWidth);
+            }
+            break;
+        }
+        case FixtureKind::Viscous:
+            damping += fixture.strength / tuning.maxSpeed[axis];
+            break;
+    }
+}
+
+bool loadFixtures (int axis, const Fixture *fixtures, int count) {
+    FixtureBuild &build = builds[axis];
+    if (build.building) {
+        return false;
+    }
+    build.count = std::min(count, fixtureLimit);
+    std::copy(fixtures, fixtures + build.count, build.fixtures);
+    build.building = true;
+    build.nextEntry = 0;
+    return true;
+}
+
+bool fixturesPending (int axis) {
+    return builds[axis].building;
+}
+
+void buildFixtures () {
+    for (int axis = 0; axis < axisCount; ++axis) {
+        FixtureBuild &build = builds[axis];
+        if (!build.building) {
+            continue;
+        }
+        FixtureTable &table = tables[axis][live[axis] ^ 1];
+        int last = std::min(build.nextEntry + fixtureBuildChunk, fixtureTableSize + 1);
+        for (int i = build.nextEntry; i < last; ++i) {
+            float position = (float)i / fixtureTableSize;
+            float force {0};
+            float damping {0};
+            for (int f = 0; f < build.count; ++f) {
+                contribute(axis, build.fixtures[f], position, force, damping);
+            }
+            table.force[i] = force;
+            table.damping[i] = damping;
+        }
+        build.nextEntry = last;
+        if (last > fixtureTableSize) {
+            table.loaded = build.count > 0;
+            live[axis] ^= 1;
+            build.building = false;
+        }
+        // One chunk a tick, whichever axis it's for.
+        return;
+    }
+}
+
+float fixtureForce (int axis) {
+    const FixtureTable &table = tables[axis][live[axis]];
+    if (!table.loaded) {
+        return 0;
+    }
+    float position = clamp(axes.command[axis], 0, 1) * fixtureTableSize;
+    int i = std::min((int)position, fixtureTableSize - 1);
+    float fraction = position - i;
+    float force = table.force[i] + (table.force[i + 1] - table.force[i]) * fraction;
+    float damping = table.damping[i] + (table.damping[i + 1] - table.damping[i]) * fraction;
+    return force - damping * axes.velocity[axis];
+}
+
+void resetFixtures () {
+    for (int axis = 0; axis < axisCount; ++axis) {
+        tables[axis][0].loaded = tables[axis][1].loaded = false;
+        builds[axis].building = false;
+    }
+}
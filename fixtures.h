@@ -0,0 +1,44 @@
+#pragma once
+
+#include "config.h"
+#include <cstdint>
+
+/*
+Virtual fixtures: forces that depend on where the rod is, added to the load cell's reading before comply() sees it,
+so it feels springs, walls, detents and sticky patches that aren't there. insertForce() with a constant, which is
+all fromMaster gets, is the simplest case of one.
+However many fixtures an axis has, they're compiled ahead of time into one table over the command range (0-1),
+fixture-table-size intervals long and interpolated, so a tick costs the same two lookups whatever's loaded. Each axis
+has two tables: ticks read the live one, while loadFixtures() has the other built a few entries a tick (by
+controlStep(), after the axes) and then swapped in between ticks. A new set takes effect all at once, and building it
+never costs a tick more than one chunk.
+Like the master push, fixtures only act while the axis is complying; moves go where they're told. They're float
+engine only: the fixed-point one doesn't apply them.
+*/
+
+enum class FixtureKind : uint8_t {
+    Spring,  // Pulls toward at, from anywhere between from and to. strength is the force per unit of travel.
+    Wall,    // Keeps out of from..to, pushing toward the nearer edge (the inside one, at an end of the range), harder
+             // the deeper in. strength is as for Spring.
+    Detent,  // A notch centered between from and to that the rod drops into. strength is the peak force.
+    Viscous, // Drag between from and to. strength is the force at maxSpeed.
+};
+
+struct Fixture {
+    FixtureKind kind;
+    float from;     // Command units, 0-1.
+    float to;
+    float strength; // inScaled units.
+    float at;       // Springs only.
+};
+
+const int fixtureLimit {8}; // In one set.
+const int fixtureTableSize {MBED_CONF_APP_FIXTURE_TABLE_SIZE};
+
+// Only from the loop, between ticks, like queueMove(). False if the axis already has a set on the way; a count of
+// zero clears it.
+bool loadFixtures (int axis, const Fixture *fixtures, int count);
+bool fixturesPending (int axis); // Loaded, and not live yet.
+void buildFixtures (); // The next chunk of whatever's pending. Once a tick.
+float fixtureForce (int axis); // At the axis's command and velocity.
+void resetFixtures (); // Every axis cleared, straight away.
@@ -0,0 +1,135 @@
+#include "flightrecorder.h"
+#include "board.h"
+#include "controller.h"
+#include "motion.h"
+#include <cstdio>
+
+static_assert(recorderTicks >= 2 && (recorderTicks & (recorderTicks - 1)) == 0,
+              "recorder-ticks must be a power of two");
+static_assert(recorderPostTicks > 0 && recorderPostTicks < recorderTicks,
+              "recorder-post-ticks must fit in recorder-ticks");
+
+const uint8_t recorderFlagMaster {1 << 0};
+const uint8_t recorderFlagMoving {1 << 1};
+const uint8_t recorderFlagAtLimit {1 << 2};
+
+// One array per value, indexed by axis then tick, the same as AxisState.
+struct FlightLog {
+    float inScaled[axisCount][recorderTicks];
+    float velocity[axisCount][recorderTicks];
+    float anticipatedAUC[axisCount][recorderTicks];
+    float command[axisCount][recorderTicks];
+    uint8_t flags[axisCount][recorderTicks];
+};
+
+struct Capture {
+    bool triggered;
+    bool frozen;
+    RecorderTrigger trigger;
+    int axis;
+    uint32_t tick; // The value of written when it fired: the tick that was under way.
+    uint64_t timeMs;
+    uint32_t missed; // Triggers that came while one was already in.
+};
+
+uint8_t recorderTriggers {MBED_CONF_APP_RECORDER_TRIGGERS};
+static FlightLog flightLog;
+static uint32_t written {}; // Ticks recorded since the last reset; the next one goes at written % recorderTicks.
+static uint32_t postLeft {};
+static Capture capture {};
+
+void recordFlight () {
+    if (capture.frozen) {
+        return;
+    }
+    uint32_t slot = written & (recorderTicks - 1);
+    uint8_t master = readMaster() ? recorderFlagMaster : 0;
+    for (int axis = 0; axis < axisCount; ++axis) {
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+        if (fixedStateCurrent(axis)) {
+            publishFixedState(axis);
+        }
+#endif
+        float command {axes.command[axis]};
+        flightLog.inScaled[axis][slot] = axes.inScaled[axis];
+        flightLog.velocity[axis][slot] = axes.velocity[axis];
+        flightLog.anticipatedAUC[axis][slot] = axes.anticipatedAUC[axis];
+        flightLog.command[axis][slot] = command;
+        flightLog.flags[axis][slot] = master | (movePending(axis) ? recorderFlagMoving : 0)
+            | (command >= axes.outMax[axis] || command <= axes.outMin[axis] ? recorderFlagAtLimit : 0);
+    }
+    ++written;
+    if (capture.triggered && --postLeft == 0) {
+        capture.frozen = true;
+    }
+}
+
+void triggerFlightRecorder (RecorderTrigger trigger, int axis) {
+    if (trigger != RecorderTrigger::Manual && (recorderTriggers & (1 << (int)trigger)) == 0) {
+        return;
+    }
+    if (capture.triggered) {
+        ++capture.missed;
+        return;
+    }
+    capture.triggered = true;
+    capture.trigger = trigger;
+    capture.axis = axis;
+    capture.tick = written;
+    capture.timeMs = clockMs();
+    postLeft = recorderPostTicks;
+}
+
+bool flightRecorderFrozen () {
+    return capture.frozen;
+}
+
+static const char *triggerName (RecorderTrigger trigger) {
+    switch (trigger) {
+        case RecorderTrigger::Manual:
+            return "manual";
+        case RecorderTrigger::MoveResisted:
+            return "move resisted";
+        case RecorderTrigger::LimitHit:
+            return "limit hit";
+        case RecorderTrigger::OddLimits:
+            return "odd calibration limits";
+        case RecorderTrigger::Stall:
+            return "control thread stalled";
+    }
+    return "?";
+}
+
+void printFlightRecorderStatus () {
+    if (!capture.triggered) {
+        printf("flight recorder: armed, %lu ticks recorded\n", (unsigned long)written);
+        return;
+    }
+    printf("flight recorder: %s on axis %d at %lu ms, %s; %lu more triggers since\n", triggerName(capture.trigger),
+           capture.axis, (unsigned long)capture.timeMs, capture.frozen ? "captured" : "still recording",
+           (unsigned long)capture.missed);
+}
+
+void dumpFlightRecorder () {
+// Ticks are numbered from the one the trigger fired in. It's a long printf, so don't call it from the control thread.
+    printFlightRecorderStatus();
+    if (!capture.frozen) {
+        return;
+    }
+    int axis {capture.axis};
+    uint32_t first = written > (uint32_t)recorderTicks ? written - recorderTicks : 0;
+    printf("tick,inScaled,velocity,anticipatedAUC,command,master,moving,atLimit\n");
+    for (uint32_t tick = first; tick < written; ++tick) {
+        uint32_t slot = tick & (recorderTicks - 1);
+        uint8_t flags = flightLog.flags[axis][slot];
+        printf("%ld,%f,%f,%f,%f,%d,%d,%d\n", (long)(int32_t)(tick - capture.tick), flightLog.inScaled[axis][slot],
+               flightLog.velocity[axis][slot], flightLog.anticipatedAUC[axis][slot], flightLog.command[axis][slot],
+               (flags & recorderFlagMaster) != 0, (flags & recorderFlagMoving) != 0,
+               (flags & recorderFlagAtLimit) != 0);
+    }
+}
+
+void resetFlightRecorder () {
+    written = 0;
+    capture = Capture {};
+}
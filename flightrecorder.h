@@ -0,0 +1,38 @@
+#pragma once
+
+#include "config.h"
+#include <cstdint>
+
+/*
+A flight recorder for the rare event nobody was logging when it happened. Every tick, whoever's running it (the
+loop, a move(), calibration), ends in waitForControlTick(), which copies each axis's inScaled, velocity,
+anticipatedAUC and command into a circular log in static RAM, with a few flags. That's a handful of stores and no
+conversions (except on the fixed-point engine, whose floats have to be published first).
+When a trigger fires, the recorder carries on for recorder-post-ticks more and then freezes, leaving the ticks
+leading up to the event and the ones after it. It stays frozen until it's been dumped and re-armed ('r' on the
+console), so the first event is the one that's kept; later ones are just counted.
+Everything but dumpFlightRecorder() belongs to the control thread. Once frozen, nothing writes the log, so the dump
+can run from anywhere; the re-arm after it goes back to the control thread.
+*/
+
+enum class RecorderTrigger : uint8_t {
+    Manual,       // Always on.
+    MoveResisted, // A queued move gave up against resistance. Not calibration's moves, where that's the point.
+    LimitHit,     // comply() hit outMin or outMax at speed, and zeroed velocity.
+    OddLimits,    // calibrate() came up with less than minimumStroke between outMin and outMax.
+    Stall,        // The control thread fell stall-ticks behind (safety.h).
+};
+
+const int recorderTicks {MBED_CONF_APP_RECORDER_TICKS};
+const int recorderPostTicks {MBED_CONF_APP_RECORDER_POST_TICKS};
+const float minimumStroke {0.1f};
+const float limitHitSpeed {0.25f}; // As a fraction of maxSpeed.
+
+extern uint8_t recorderTriggers; // Bit (1 << trigger) enables that trigger. Starts as recorder-triggers.
+
+void recordFlight (); // Once per tick.
+void triggerFlightRecorder (RecorderTrigger trigger, int axis);
+bool flightRecorderFrozen ();
+void printFlightRecorderStatus ();
+void dumpFlightRecorder (); // The capture as CSV on the console, if it's frozen. resetFlightRecorder() re-arms it.
+void resetFlightRecorder ();
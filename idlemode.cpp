@@ -0,0 +1,92 @@
+#include "idlemode.h"
+#include "board.h"
+#include "controller.h"
+#include "looptimer.h"
+#include <cstdio>
+
+IdleStats idleStats {};
+bool idleScheduling {MBED_CONF_APP_IDLE_SCHEDULING};
+
+static const uint32_t idleAfterTicks {(uint32_t)MBED_CONF_APP_IDLE_AFTER_MS * 1000 / MBED_CONF_APP_CONTROL_PERIOD_US};
+static const uint32_t idleDivider {MBED_CONF_APP_IDLE_DIVIDER};
+// Resting ticks so far, up to idleAfterTicks, which means idle. Then phase counts round the divider.
+static uint32_t restingTicks[axisCount] {};
+static uint32_t phase[axisCount] {};
+
+static bool isIdle (int axis) {
+    return restingTicks[axis] >= idleAfterTicks;
+}
+
+bool complyDue (int axis, bool resting) {
+// The tick that first reads a force over idleWakeForce complies; the cost of idling is the wander idlemode.h describes.
+    if (!idleScheduling) {
+        return true;
+    }
+    if (!resting) {
+        keepAwake(axis);
+        return true;
+    }
+    if (!isIdle(axis)) {
+        if (++restingTicks[axis] == idleAfterTicks) {
+            ++idleStats.entries;
+            phase[axis] = 0;
+        }
+        return true;
+    }
+    phase[axis] = phase[axis] + 1 < idleDivider ? phase[axis] + 1 : 0;
+    if (phase[axis] != 0) {
+        ++idleStats.coasted;
+        return false;
+    }
+    return true;
+}
+
+void keepAwake (int axis) {
+    if (isIdle(axis)) {
+        ++idleStats.wakes;
+    }
+    restingTicks[axis] = 0;
+}
+
+void recordTickCost (uint32_t cycles) {
+    bool allIdle {idleScheduling};
+    for (int axis = 0; axis < axisCount && allIdle; ++axis) {
+        allIdle = isIdle(axis);
+    }
+    ++idleStats.ticks;
+    if (allIdle) {
+        ++idleStats.idleTicks;
+        idleStats.idleCycles += cycles;
+    }
+    else {
+        idleStats.activeCycles += cycles;
+    }
+}
+
+void resetIdleMode () {
+    for (int axis = 0; axis < axisCount; ++axis) {
+        restingTicks[axis] = 0;
+        phase[axis] = 0;
+    }
+    idleStats = IdleStats {};
+}
+
+void printIdleStats () {
+    if (idleStats.ticks == 0) {
+        printf("No idle stats yet.\n");
+        return;
+    }
+    uint32_t activeTicks = idleStats.ticks - idleStats.idleTicks;
+    printf("idle: %lu of %lu ticks (%.1f%%); %lu entries, %lu wakes; %lu ticks coasted\n",
+           (unsigned long)idleStats.idleTicks, (unsigned long)idleStats.ticks,
+           100.0f * idleStats.idleTicks / idleStats.ticks, (unsigned long)idleStats.entries,
+           (unsigned long)idleStats.wakes, (unsigned long)idleStats.coasted);
+    // What the loop costs against what it would have cost if every tick had been an active one.
+    float activeMean = activeTicks > 0 ? (float)idleStats.activeCycles / activeTicks : 0;
+    float idleMean = idleStats.idleTicks > 0 ? (float)idleStats.idleCycles / idleStats.idleTicks : 0;
+    float periodCycles = (float)cycleCountHz() * loopTiming.periodUs / 1e6f;
+    float busy = (float)(idleStats.activeCycles + idleStats.idleCycles) / idleStats.ticks / periodCycles;
+    printf("  tick work: mean %lu cycles active, %lu idle; CPU %.2f%% busy, against %.2f%% with comply() every tick\n",
+           (unsigned long)activeMean, (unsigned long)idleMean, 100 * busy,
+           activeTicks > 0 ? 100 * activeMean / periodCycles : 100 * busy);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "config.h"
+#include <cstdint>
+
+/*
+Most of the time nobody's touching the rod, and comply() is working out, a thousand times a second, what to make of
+amplifier noise. Once an axis's force has stayed under idleWakeForce for idle-after-ms, it goes idle: the full
+comply() only runs on every idle-divider'th tick, and the rest just coast() (velocity decays and the command
+carries on, exactly as comply() would have it with no force). The force is still read every tick, so the first
+reading over the threshold wakes the axis in that same tick.
+An idle axis coasts to a stop the same as ever, but what's under the threshold isn't just weakened. Every tick,
+comply()'s kicks from the noise mostly cancel on the next, and the command dithers in place. Idle, the velocity from
+each one is carried for the divider's worth of ticks, so the command wanders off slowly, and a push can find the
+actuator moving the other way: bench's push_to_motion_us goes from 13ms to 14. That's why it ships off.
+The predictor's work saved is time the CPU spends asleep in waitForControlTick(), or that something else can have.
+'i' on the console prints how much time was spent idle and what it saved.
+*/
+
+const float idleWakeForce {MBED_CONF_APP_IDLE_WAKE_FORCE}; // In inScaled units.
+
+struct IdleStats {
+    uint32_t ticks;
+    uint32_t idleTicks;     // Ticks with every axis idle.
+    uint32_t coasted;       // Ticks an idle axis coasted instead of complying, over all the axes.
+    uint32_t entries;
+    uint32_t wakes;
+    uint64_t activeCycles;  // controlStep()'s own time, by cycleCount(), on ticks that weren't idle...
+    uint64_t idleCycles;    // ...and on ticks that were.
+};
+
+extern IdleStats idleStats;
+extern bool idleScheduling; // Starts out as idle-scheduling in mbed_app.json. Off, comply() runs every tick.
+
+// Once per tick per axis, in place of comply(), with whether the force is under idleWakeForce. False means coast().
+bool complyDue (int axis, bool resting);
+void keepAwake (int axis); // For ticks when a move has the axis.
+void recordTickCost (uint32_t cycles);
+void resetIdleMode (); // Every axis back to awake, and the stats to zero.
+void printIdleStats ();
@@ -0,0 +1,119 @@
+#include "looptimer.h"
+#include "board.h"
+#include "config.h"
+#include "flightrecorder.h"
+#include "safety.h"
+#include <cstdio>
+
+static_assert(MBED_CONF_APP_CONTROL_DEADLINE_US <= MBED_CONF_APP_CONTROL_PERIOD_US,
+              "control-deadline-us past control-period-us would let a tick overrun without being a miss");
+
+LoopTiming loopTiming {};
+static uint32_t lastWakeUs {};
+static bool haveLastWake {false};
+
+void resetLoopTiming () {
+    uint32_t periodUs = loopTiming.periodUs;
+    loopTiming = LoopTiming {};
+    loopTiming.periodUs = periodUs;
+    // Sixteen bins either side of nominal, each 1/64th of a period wide (16us at 1kHz), so +/-25% is itemized.
+    loopTiming.binUs = periodUs / 64 > 0 ? periodUs / 64 : 1;
+    loopTiming.minUs = UINT32_MAX;
+    haveLastWake = false;
+}
+
+void startControlLoop (uint32_t periodUs) {
+#if MBED_CONF_APP_FIXED_RATE_LOOP
+    loopTiming.periodUs = periodUs;
+    startTicker(periodUs);
+#else
+    // Legacy pacing is always "1ms of sleep", whatever was asked for.
+    (void)periodUs;
+    loopTiming.periodUs = 1000;
+#endif
+    resetLoopTiming();
+}
+
+static void recordPeriod (uint32_t us) {
+    if (us < loopTiming.minUs) {
+        loopTiming.minUs = us;
+    }
+    if (us > loopTiming.maxUs) {
+        loopTiming.maxUs = us;
+    }
+    loopTiming.totalUs += us;
+    ++loopTiming.samples;
+    int32_t offset = (int32_t)(us - loopTiming.periodUs) + (int32_t)(loopTiming.binUs * loopHistogramBins / 2);
+    if (offset < 0) {
+        ++loopTiming.tooShort;
+    }
+    else if (offset / loopTiming.binUs >= (uint32_t)loopHistogramBins) {
+        ++loopTiming.tooLong;
+    }
+    else {
+        ++loopTiming.histogram[offset / loopTiming.binUs];
+    }
+}
+
+void waitForControlTick () {
+/*
+Returns at the start of the next control period. Call it once per tick, after the tick's work is done.
+The flight recorder takes its copy of the tick on the way in, and the watchdog gets its kick on the way out.
+*/
+    recordFlight();
+    if (haveLastWake) {
+        uint32_t busyUs = clockUs() - lastWakeUs;
+        if (busyUs > loopTiming.worstBusyUs) {
+            loopTiming.worstBusyUs = busyUs;
+        }
+        if (busyUs > MBED_CONF_APP_CONTROL_DEADLINE_US) {
+            ++loopTiming.deadlineMisses;
+        }
+    }
+#if MBED_CONF_APP_FIXED_RATE_LOOP
+    uint32_t elapsed = waitForTicker();
+    if (elapsed > 1) {
+        loopTiming.overruns += elapsed - 1;
+    }
+#else
+    sleepMs(1);
+#endif
+    uint32_t now = clockUs();
+    if (haveLastWake) {
+        recordPeriod(now - lastWakeUs);
+    }
+    lastWakeUs = now;
+    haveLastWake = true;
+    serviceSafety();
+}
+
+void idleFor (uint32_t ms) {
+// Sits out a number of milliseconds on the loop's own schedule, so the pause doesn't read as one giant overrun.
+    uint32_t ticks = (uint32_t)((uint64_t)ms * 1000 / loopTiming.periodUs);
+    for (uint32_t i = 0; i < ticks; ++i) {
+        waitForControlTick();
+    }
+}
+
+void printLoopTiming () {
+    if (loopTiming.samples == 0) {
+        printf("No loop timing yet.\n");
+        return;
+    }
+    printf("period %lu us: min %lu, mean %lu, max %lu over %lu ticks; %lu overruns\n",
+           (unsigned long)loopTiming.periodUs, (unsigned long)loopTiming.minUs,
+           (unsigned long)(loopTiming.totalUs / loopTiming.samples), (unsigned long)loopTiming.maxUs,
+           (unsigned long)loopTiming.samples, (unsigned long)loopTiming.overruns);
+    printf("  work: worst %lu us; %lu ticks past the %lu us deadline\n", (unsigned long)loopTiming.worstBusyUs,
+           (unsigned long)loopTiming.deadlineMisses, (unsigned long)MBED_CONF_APP_CONTROL_DEADLINE_US);
+    uint32_t binStart = loopTiming.periodUs - loopTiming.binUs * loopHistogramBins / 2;
+    printf("  < %lu us: %lu\n", (unsigned long)binStart, (unsigned long)loopTiming.tooShort);
+    for (int i = 0; i < loopHistogramBins; ++i) {
+        if (loopTiming.histogram[i] != 0) {
+            printf("  %lu-%lu us: %lu\n", (unsigned long)(binStart + i * loopTiming.binUs),
+                   (unsigned long)(binStart + (i + 1) * loopTiming.binUs - 1), (unsigned long)loopTiming.histogram[i]);
+        }
+    }
+    printf("  >= %lu us: %lu\n", (unsigned long)(binStart + loopHistogramBins * loopTiming.binUs),
+           (unsigned long)loopTiming.tooLong);
+}
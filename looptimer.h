@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+Paces the control loop and keeps score of how well it's doing it.
+With fixed-rate-loop on, ticks come from a hardware ticker, so the period doesn't stretch with however long the
+tick's work took. With it off, it's the old sleep-1ms-after-the-work behaviour, which is still worth measuring.
+*/
+
+const int loopHistogramBins {32};
+
+struct LoopTiming {
+    uint32_t periodUs;
+    uint32_t binUs;        // Width of each histogram bin. Bins are centered on periodUs.
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+    uint32_t samples;
+    uint32_t overruns;     // Ticks that came and went while the loop was still busy with an earlier one.
+    uint32_t deadlineMisses; // Ticks whose work took longer than control-deadline-us, whether or not they overran.
+    uint32_t worstBusyUs;  // The longest any tick's work took, from waking to calling waitForControlTick() again.
+    uint32_t tooShort;     // Periods below the first bin.
+    uint32_t tooLong;      // Periods past the last bin.
+    uint32_t histogram[loopHistogramBins];
+};
+
+extern LoopTiming loopTiming;
+
+void startControlLoop (uint32_t periodUs);
+void waitForControlTick ();
+void idleFor (uint32_t ms);
+void resetLoopTiming ();
+void printLoopTiming ();
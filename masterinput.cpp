@@ -0,0 +1,110 @@
+#include "masterinput.h"
+#include "board.h"
+#include <cstdio>
+
+MasterInputStats masterInputStats {};
+static bool level {false};
+static uint32_t periodStartUs {};
+// The edges the last drain handed over, waiting for masterActuated(). Ages are as of drainedUs.
+static uint32_t drainedUs {};
+static uint32_t pendingEdges {};
+static uint32_t pendingNewestAgeUs {};
+static uint32_t pendingOldestAgeUs {};
+static uint64_t pendingAgeTotalUs {};
+
+void resetMasterInput () {
+// Throws away any edges logged so far and starts the stats over. The next drain's period starts now.
+    MasterEdge edge;
+    while (popMasterEdge(edge)) {
+    }
+    masterEdgesLost(); // Forgotten too: level's about to come from the pin anyway.
+    level = readMaster();
+    periodStartUs = clockUs();
+    pendingEdges = 0;
+    masterInputStats = MasterInputStats {};
+    masterInputStats.latencyMinUs = UINT32_MAX;
+}
+
+MasterTick drainMasterInput () {
+/*
+Once per tick, before anything acts on fromMaster. Works out how long it was high since the last drain from the
+logged edges, and leaves those edges for masterActuated() to time.
+*/
+    uint32_t now = clockUs();
+    uint32_t period = now - periodStartUs;
+    uint32_t cursor {0}; // Everything from here on is an offset into the period.
+    uint32_t highUs {0};
+    MasterTick tick {false, false, 0};
+    pendingEdges = 0;
+    pendingAgeTotalUs = 0;
+    // Read before the ring's emptied. It's only the tiebreak if edges were lost; otherwise they're the record.
+    bool pin = readMaster();
+    MasterEdge edge;
+    while (popMasterEdge(edge)) {
+        // The interrupt can fire mid-drain, or just before the last one read the clock: those count as the ends.
+        int32_t at = (int32_t)(edge.timeUs - periodStartUs);
+        uint32_t offset = at < 0 ? 0 : (uint32_t)at > period ? period : (uint32_t)at;
+        if (offset < cursor) {
+            offset = cursor;
+        }
+        if (level) {
+            highUs += offset - cursor;
+        }
+        cursor = offset;
+        level = edge.rising;
+        tick.rose |= edge.rising;
+        uint32_t age = period - offset;
+        if (pendingEdges == 0) {
+            pendingOldestAgeUs = age;
+        }
+        pendingNewestAgeUs = age;
+        pendingAgeTotalUs += age;
+        ++pendingEdges;
+        ++masterInputStats.edges;
+    }
+    if (level) {
+        highUs += period - cursor;
+    }
+    if (masterEdgesLost() && level != pin) {
+        // The ring overflowed, so the edges can't be trusted to add up. The pin can.
+        level = pin;
+        tick.rose |= level;
+        ++masterInputStats.resyncs;
+    }
+    tick.high = level;
+    tick.duty = period > 0 ? (float)highUs / period : level ? 1 : 0;
+    periodStartUs = now;
+    drainedUs = now;
+    return tick;
+}
+
+void masterActuated () {
+// Once the tick's actuator writes are out: times every edge the last drain handed over, from the edge to now.
+    if (pendingEdges == 0) {
+        return;
+    }
+    uint32_t sinceDrain = clockUs() - drainedUs;
+    uint32_t newest = pendingNewestAgeUs + sinceDrain;
+    uint32_t oldest = pendingOldestAgeUs + sinceDrain;
+    if (newest < masterInputStats.latencyMinUs) {
+        masterInputStats.latencyMinUs = newest;
+    }
+    if (oldest > masterInputStats.latencyMaxUs) {
+        masterInputStats.latencyMaxUs = oldest;
+    }
+    masterInputStats.latencyTotalUs += pendingAgeTotalUs + (uint64_t)pendingEdges * sinceDrain;
+    masterInputStats.latencySamples += pendingEdges;
+    pendingEdges = 0;
+}
+
+void printMasterInputStats () {
+    printf("fromMaster: %lu edges, %lu resyncs\n", (unsigned long)masterInputStats.edges,
+           (unsigned long)masterInputStats.resyncs);
+    if (masterInputStats.latencySamples == 0) {
+        return;
+    }
+    printf("  edge to actuator: min %lu us, mean %lu us, max %lu us over %lu edges\n",
+           (unsigned long)masterInputStats.latencyMinUs,
+           (unsigned long)(masterInputStats.latencyTotalUs / masterInputStats.latencySamples),
+           (unsigned long)masterInputStats.latencyMaxUs, (unsigned long)masterInputStats.latencySamples);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+fromMaster, as the control tick sees it. The board logs every edge from the pin interrupt with its time, so a pulse
+that starts and ends between two ticks still counts, and counts for as long as it lasted: each tick gets the fraction
+of the last period the input spent high, not a one-off sample of its level. The tick still has to come round before
+anything moves; masterActuated() keeps score of how long that takes.
+*/
+
+struct MasterTick {
+    bool high;  // The level at the end of the period.
+    bool rose;  // There was at least one rising edge in it.
+    float duty; // Fraction of the period spent high, 0-1.
+};
+
+struct MasterInputStats {
+    uint32_t edges;
+    uint32_t resyncs; // The ring overflowed and lost an edge, and the pin disagreed with the rest, so the pin won.
+    uint32_t latencySamples;
+    uint32_t latencyMinUs; // Edge to the end of the tick that acted on it.
+    uint32_t latencyMaxUs;
+    uint64_t latencyTotalUs;
+};
+
+extern MasterInputStats masterInputStats;
+
+void resetMasterInput ();
+MasterTick drainMasterInput ();
+void masterActuated ();
+void printMasterInputStats ();
@@ -0,0 +1,232 @@
+#include "motion.h"
+#include "board.h"
+#include "config.h"
+#include "controller.h"
+#include "looptimer.h"
+#include "masterinput.h"
+#include "spscring.h"
+#include <cmath>
+
+struct MoveRequest {
+    float to;
+    MotionLimits limits;
+    bool yield;
+    float compliance;
+};
+
+struct MoveEngine {
+    // Only the control loop uses it at the moment, but it's safe for something else (an ISR, say) to be queueing moves.
+    SpscRing<MoveRequest, 8> queue;
+    bool active;
+    MoveRequest current;
+    Trajectory plan;
+    float planStart; // Ticks since baseUs.
+    bool blending;
+    MoveRequest next;
+    Trajectory nextPlan;
+    float nextStart;
+    uint32_t baseUs;
+    float offset; // How far compliance has pushed the rod off the planned path.
+    MoveEnd end;
+};
+
+static MoveEngine engines[axisCount];
+// Only the first axis has the real DAC, so only it can stream.
+static bool streaming {false};
+static uint32_t streamCount {};
+static float ticksPerSample {};
+
+bool queueMove (int axis, float to, const MotionLimits &limits, bool yield, float compliance) {
+    to = clamp(to, axes.outMin[axis], axes.outMax[axis]);
+    return engines[axis].queue.push(MoveRequest {to, limits, yield, clamp(compliance, 0.0, 1.0)});
+}
+
+bool movePending (int axis) {
+    return engines[axis].active || !engines[axis].queue.empty();
+}
+
+MoveEnd lastMoveEnd (int axis) {
+    return engines[axis].end;
+}
+
+MotionLimits fullSpeed (int axis) {
+    return MotionLimits {tuning.maxSpeed[axis], tuning.maxAcceleration[axis], tuning.maxJerk[axis]};
+}
+
+static void endMoves (int axis, MoveEnd why) {
+    MoveEngine &engine = engines[axis];
+    if (axis == 0 && streaming) {
+        // Stopping the stream leaves the DAC wherever it got to, which is what command already says.
+        stopDacStream();
+        streaming = false;
+    }
+    MoveRequest dropped;
+    while (engine.queue.pop(dropped)) {
+    }
+    engine.active = false;
+    engine.blending = false;
+    axes.velocity[axis] = 0.0;
+    engine.end = why;
+}
+
+void cancelMoves (int axis) {
+    if (movePending(axis)) {
+        endMoves(axis, MoveEnd::Preempted);
+    }
+}
+
+#if MBED_CONF_APP_DAC_STREAMING
+static void startStream (const Trajectory &plan) {
+/*
+A move with nothing behind it and no compliance is planned out up front and handed to the board, which plays it out
+to the DAC on its own timer, faster than the control loop runs; the ticks just keep watch.
+A move longer than the buffer gets a lower sample rate rather than being cut short; the buffer is sized so that
+even then, a full-range move still gets a sample for every DAC step.
+*/
+    uint32_t rate = MBED_CONF_APP_DAC_STREAM_RATE_HZ;
+    float durationUs = plan.duration * loopTiming.periodUs;
+    streamCount = (uint32_t)(durationUs * rate / 1000000);
+    if (streamCount > dacStreamCapacity()) {
+        streamCount = dacStreamCapacity();
+        rate = (uint32_t)(streamCount * 1000000.0f / durationUs);
+    }
+    if (streamCount == 0) {
+        streamCount = 1;
+    }
+    // Each sample is where the profile should be at the end of its slot, so the last one lands on plan.to exactly.
+    ticksPerSample = plan.duration / streamCount;
+    for (uint32_t i = 0; i < streamCount; ++i) {
+        float position = clamp(trajectoryPosition(plan, (i + 1) * ticksPerSample), axes.outMin[0], axes.outMax[0]);
+        setDacStreamSample(i, (uint16_t)(position * 0xFFFF + 0.5f));
+    }
+    startDacStream(streamCount, rate);
+    streaming = true;
+}
+#endif
+
+static void startMove (int axis) {
+    MoveEngine &engine = engines[axis];
+    engine.baseUs = clockUs();
+    engine.planStart = 0;
+    engine.offset = 0;
+    axes.velocity[axis] = 0.0;
+    engine.plan = planTrajectory(axes.command[axis], engine.current.to, engine.current.limits);
+    engine.active = true;
+    engine.end = MoveEnd::None;
+#if MBED_CONF_APP_DAC_STREAMING
+    if (axis == 0 && engine.current.compliance == 0 && engine.queue.empty()) {
+        startStream(engine.plan);
+    }
+#endif
+}
+
+static bool stepStream () {
+    MoveEngine &engine = engines[0];
+    uint32_t played = dacStreamProgress();
+    axes.command[0] = played == 0 ? engine.plan.from : trajectoryPosition(engine.plan, played * ticksPerSample);
+    if (played >= streamCount) {
+        stopDacStream();
+        streaming = false;
+        axes.command[0] = engine.plan.to;
+        engine.active = false;
+        engine.end = MoveEnd::Arrived;
+    }
+    return true;
+}
+
+bool stepMove (int axis, bool masterRose) {
+    MoveEngine &engine = engines[axis];
+    if (masterRose && movePending(axis)) {
+        endMoves(axis, MoveEnd::Preempted);
+        return false;
+    }
+    if (!engine.active) {
+        if (!engine.queue.pop(engine.current)) {
+            return false;
+        }
+        startMove(axis);
+    }
+    float inScaled = axes.inScaled[axis];
+    if ((inScaled > 0.15 || inScaled < -0.15) && engine.current.yield == true) {
+        endMoves(axis, MoveEnd::Resisted);
+        return false;
+    }
+    if (streaming && axis == 0) {
+        return stepStream();
+    }
+
+    float now = (float)(clockUs() - engine.baseUs) / loopTiming.periodUs;
+    // Once this move starts slowing down, the next one can start speeding up. Their profiles add, and for moves with
+    // the same limits, the speed lost by one is exactly what the other gains.
+    if (!engine.blending && now - engine.planStart >= engine.plan.segmentStart[4] && engine.queue.pop(engine.next)) {
+        engine.blending = true;
+        engine.nextStart = now;
+        engine.nextPlan = planTrajectory(engine.plan.to, engine.next.to, engine.next.limits);
+    }
+    float planned = trajectoryPosition(engine.plan, now - engine.planStart);
+    if (engine.blending) {
+        planned += trajectoryPosition(engine.nextPlan, now - engine.nextStart) - engine.nextPlan.from;
+    }
+    if (engine.current.compliance > 0) {
+        updateVelocity(axis);
+        engine.offset += engine.current.compliance * axes.velocity[axis];
+    }
+    // Inside the calibrated range, however hard compliance is pushed; calibrate() opens it up while it looks.
+    float command = clamp(planned + engine.offset, axes.outMin[axis], axes.outMax[axis]);
+    axes.command[axis] = command;
+    writeActuator(axis, command);
+    if (command >= axes.outMax[axis] || command <= axes.outMin[axis]) {
+        axes.velocity[axis] = 0;
+    }
+
+    if (now - engine.planStart >= engine.plan.duration) {
+        if (engine.blending) {
+            engine.current = engine.next;
+            engine.plan = engine.nextPlan;
+            engine.planStart = engine.nextStart;
+            engine.blending = false;
+        }
+        else {
+            engine.active = false;
+            axes.velocity[axis] = 0.0;
+            engine.end = MoveEnd::Arrived;
+        }
+    }
+    return true;
+}
+
+bool move (int axis, float to, const MotionLimits &limits, bool yield) {
+/*
+Moves the actuator to position "to" as quickly as the limits allow, easing in and out so there's no jolt at
+either end (see trajectory.h). Doesn't return until it's done, and nothing else gets the tick in the meantime.
+By default, the movement will yield to even a small resistance, meaning it's not intended for use under load.
+If yield = false, though, the movement will be forced. fromMaster is ignored unless it goes high mid-move.
+*/
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    // Moves are worked out in floats, so bring those up to date first and hand the result back after.
+    publishFixedState(axis);
+#endif
+    cancelMoves(axis);
+    // Only edges from here on count.
+    drainMasterInput();
+    queueMove(axis, to, limits, yield);
+    while (true) {
+        MasterTick master = drainMasterInput();
+        readInputs(axis);
+        bool moved = stepMove(axis, master.rose);
+        masterActuated();
+        if (!moved || !movePending(axis)) {
+            break;
+        }
+        waitForControlTick();
+    }
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    syncFixedFromFloat(axis);
+#endif
+    return engines[axis].end == MoveEnd::Arrived;
+}
+
+bool move (int axis, float to, bool yield) {
+// The same, at the actuator's full speed.
+    return move(axis, to, fullSpeed(axis), yield);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "trajectory.h"
+
+/*
+The move engine. Moves are queued, then stepped once per control tick by controlStep(), in place of comply(), until
+the queue runs dry; the loop never stalls inside a move, and it still reacts to the load cell and fromMaster within
+the tick. A move that's queued while another is decelerating is blended onto the end of it, so a string of moves
+flows through its waypoints without stopping at each one.
+Compliance blends the move with comply()'s behaviour: 0 follows the path exactly; at 1, pushing on the rod moves it
+off the path as freely as when it's floating, and the rest of the move carries on from wherever it was pushed to.
+A rising edge on fromMaster cancels everything. So does resistance, for moves that yield to it.
+Every axis has its own queue and engine. Moves, and anything compliance adds to them, stay inside the axis's
+calibrated outMin..outMax.
+*/
+
+enum class MoveEnd {
+    None,
+    Arrived,
+    Resisted,
+    Preempted,
+};
+
+bool queueMove (int axis, float to, const MotionLimits &limits, bool yield = true, float compliance = 0);
+bool movePending (int axis); // A move is running or queued.
+void cancelMoves (int axis);
+MoveEnd lastMoveEnd (int axis);
+// Returns false if there was no move to step, and so comply() should have the tick. masterRose is from drainMasterInput().
+bool stepMove (int axis, bool masterRose);
+MotionLimits fullSpeed (int axis); // The axis's maxSpeed, maxAcceleration and maxJerk.
+
+// Blocking moves, for calibration: queue one move (after cancelling any others), then run it to the end.
+bool move (int axis, float to, const MotionLimits &limits, bool yield = true);
+bool move (int axis, float to, bool yield = true); // At fullSpeed().
@@ -0,0 +1,45 @@
+#include "mpc.h"
+#include "controller.h"
+#include "estimator.h"
+#include "mpcgains.h"
+#include <cmath>
+
+static_assert(mpcSlickness == FactoryTuning::slickness(0),
+              "mpcgains.h was solved for another slickness; rerun tools/mpc_gains.py");
+
+static const MpcGains &gainsFor (int horizon) {
+// The longest horizon in the table that isn't longer than the one asked for (or the shortest there is).
+    int row {0};
+    while (row + 1 < mpcHorizonCount && mpcGains[row + 1].horizon <= horizon) {
+        ++row;
+    }
+    return mpcGains[row];
+}
+
+float mpcVelocity (int axis, float inertia, int horizon, float maxSpeed, float maxAcceleration) {
+    const MpcGains &gains = gainsFor(horizon);
+    float velocity = axes.velocity[axis];
+    float acceleration = gains.velocity * velocity
+        + (gains.force * axes.inScaled[axis] + gains.rate * forceRate(axis)) / inertia;
+    axes.anticipatedAUC[axis] = 0;
+    velocity = clamp(velocity + clamp(acceleration, -maxAcceleration, maxAcceleration), -maxSpeed, maxSpeed);
+    // Braking at maxAcceleration a tick at a time covers v^2 / 2a + v / 2 before it stops: that can't be more than
+    // the room left before the limit it's heading for.
+    float room = velocity > 0 ? axes.outMax[axis] - axes.command[axis] : axes.command[axis] - axes.outMin[axis];
+    float halfStep = maxAcceleration / 2;
+    float stoppable = sqrtf(halfStep * halfStep + 2 * maxAcceleration * (room > 0 ? room : 0)) - halfStep;
+    if (std::fabs(velocity) > stoppable) {
+        velocity = std::copysign(stoppable, velocity);
+    }
+    return velocity;
+}
+
+const char *complianceModeName (ComplianceMode mode) {
+    switch (mode) {
+        case ComplianceMode::Predictor:
+            return "predictor";
+        case ComplianceMode::Mpc:
+            return "mpc";
+    }
+    return "?";
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+An alternative to comply()'s predictor, picked per axis with AxisTuning.compliance (compliance-mode in mbed_app.json):
+a small linear model-predictive controller.
+The model is the virtual mass-damper that inertia and slickness describe. Each tick, velocity decays by slickness
+and the force accelerates it by force * mpcForceGain / inertia. Over the next horizon ticks, with the force carried
+on at forceRate() (the same extrapolation calculateFutureAUC() makes), the actuator's velocity should follow the
+model's for as little acceleration as it can. Without the limits that's a least-squares problem, and its answer is
+linear in velocity, force and forceRate(). So tools/mpc_gains.py solves it offline, keeps only the first step, and
+writes three gains per horizon to mpcgains.h. On target, a tick is a three-term dot product.
+The limits go on afterwards rather than into the optimization. Acceleration is clamped to maxAcceleration and
+velocity to maxSpeed. Then velocity is clamped to what can still brake to a stop, at maxAcceleration, before outMin
+or outMax, so unlike comply() it doesn't arrive at a limit at speed.
+The table's solved for one slickness, and mpc.cpp static_asserts that it's FactoryTuning's. Inertia is divided out
+at run time and predictXCyclesAhead picks the row, so LiveTuning's values for those two still count. Float engine only.
+*/
+
+enum class ComplianceMode : uint8_t {
+    Predictor, // calculateFutureAUC() and specialSauce(), as it always was.
+    Mpc,
+};
+
+struct MpcGains {
+    int horizon;
+    float velocity;
+    float force; // This one and rate are for an inertia of 1.
+    float rate;
+};
+
+// This tick's velocity, limits and all. Sets anticipatedAUC to zero: there's no prediction area here.
+float mpcVelocity (int axis, float inertia, int horizon, float maxSpeed, float maxAcceleration);
+const char *complianceModeName (ComplianceMode mode);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "mpc.h"
+
+// Generated by: tools/mpc_gains.py --slickness 0.999 --effort 30 --force-gain 4.2e-05 --horizons 5,10,20,40
+// Don't edit; rerun it. One row per horizon: horizon, then the gains on velocity, force and forceRate().
+
+constexpr float mpcSlickness {0.999f};
+constexpr float mpcEffortWeight {30.0f};
+constexpr float mpcForceGain {4.2e-05f};
+const int mpcHorizonCount {4};
+const MpcGains mpcGains[mpcHorizonCount] {
+    {5, -0.000350174884f, 1.47073451e-05f, 1.8813221e-05f},
+    {10, -0.000708341064f, 2.97503247e-05f, 7.83108609e-05f},
+    {20, -0.000948182889f, 3.98236813e-05f, 0.00016898468f},
+    {40, -0.000993826419f, 4.17407096e-05f, 0.000206901345f},
+};
@@ -0,0 +1,115 @@
+#include "profiler.h"
+#include "looptimer.h"
+#include <cstdio>
+
+StageProfile stageProfiles[(int)ProfileStage::Count] {};
+StageProfile axisProfiles[MBED_CONF_APP_AXES] {};
+
+static const char *const stageNames[] {"read", "predict", "update", "output", "tick"};
+
+static int binFor (uint32_t cycles) {
+    if (cycles < 4) {
+        return cycles;
+    }
+    // The octave is the position of the top bit; the two bits under it pick the quarter.
+    int octave = 31 - __builtin_clz(cycles);
+    int bin = octave * 4 + ((cycles >> (octave - 2)) & 3) - 4;
+    return bin < profileBins ? bin : profileBins;
+}
+
+static uint32_t binFloor (int bin) {
+// The smallest cycle count that lands in a bin; the inverse of binFor().
+    if (bin < 4) {
+        return bin;
+    }
+    int octave = (bin + 4) / 4;
+    return (uint32_t)(4 + (bin + 4) % 4) << (octave - 2);
+}
+
+static void record (StageProfile &profile, uint32_t cycles) {
+    ++profile.samples;
+    profile.total += cycles;
+    if (cycles > profile.worst) {
+        profile.worst = cycles;
+    }
+    ++profile.histogram[binFor(cycles)];
+}
+
+void recordStage (ProfileStage stage, uint32_t cycles) {
+    record(stageProfiles[(int)stage], cycles);
+}
+
+void recordAxis (int axis, uint32_t cycles) {
+    record(axisProfiles[axis], cycles);
+}
+
+void resetProfile () {
+    for (StageProfile &profile : stageProfiles) {
+        profile = StageProfile {};
+    }
+    for (StageProfile &profile : axisProfiles) {
+        profile = StageProfile {};
+    }
+}
+
+static uint32_t percentile (const StageProfile &profile, uint32_t perThousand) {
+// Reports the top of the bin the percentile falls in, so it errs on the pessimistic side.
+    uint64_t wanted = ((uint64_t)profile.samples * perThousand + 999) / 1000;
+    uint64_t seen {0};
+    for (int bin = 0; bin <= profileBins; ++bin) {
+        seen += profile.histogram[bin];
+        if (seen >= wanted) {
+            if (bin == profileBins) {
+                return profile.worst;
+            }
+            uint32_t top = binFloor(bin + 1) - 1;
+            return top < profile.worst ? top : profile.worst;
+        }
+    }
+    return profile.worst;
+}
+
+static void printRow (const char *name, const StageProfile &profile) {
+    if (profile.samples == 0) {
+        return;
+    }
+    printf("%-8s %9lu %8lu %8lu %8lu %8lu %8lu %8lu\n", name, (unsigned long)profile.samples,
+           (unsigned long)(profile.total / profile.samples), (unsigned long)percentile(profile, 500),
+           (unsigned long)percentile(profile, 900), (unsigned long)percentile(profile, 990),
+           (unsigned long)percentile(profile, 999), (unsigned long)profile.worst);
+}
+
+void printProfile () {
+    if (!MBED_CONF_APP_PROFILING) {
+        printf("Profiling is off; turn on \"profiling\" in mbed_app.json.\n");
+        return;
+    }
+    printf("stage      samples     mean      p50      p90      p99    p99.9    worst (cycles)\n");
+    for (int i = 0; i < (int)ProfileStage::Count; ++i) {
+        printRow(stageNames[i], stageProfiles[i]);
+    }
+    uint32_t axisP99 {0};
+    uint64_t axisMeans {0};
+    for (int axis = 0; axis < MBED_CONF_APP_AXES; ++axis) {
+        const StageProfile &profile = axisProfiles[axis];
+        char name[12];
+        snprintf(name, sizeof(name), "axis %d", axis);
+        printRow(name, profile);
+        if (profile.samples != 0) {
+            uint32_t p99 = percentile(profile, 990);
+            axisP99 = p99 > axisP99 ? p99 : axisP99;
+            axisMeans += profile.total / profile.samples;
+        }
+    }
+    // What's left of the tick after the axes (pacing, the fromMaster read...) doesn't grow with the axis count.
+    const StageProfile &tick = stageProfiles[(int)ProfileStage::Tick];
+    if (tick.samples == 0 || axisP99 == 0) {
+        return;
+    }
+    uint64_t budget = (uint64_t)loopTiming.periodUs * cycleCountHz() / 1000000;
+    uint64_t tickMean = tick.total / tick.samples;
+    uint64_t overhead = tickMean > axisMeans ? tickMean - axisMeans : 0;
+    uint64_t fit = budget > overhead ? (budget - overhead) / axisP99 : 0;
+    printf("at %lu cycles per axis (worst p99), %lu axes would fit in the %lu us period\n", (unsigned long)axisP99,
+           (unsigned long)fit, (unsigned long)loopTiming.periodUs);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "board.h"
+#include "config.h"
+#include <cstdint>
+
+/*
+Per-stage cycle counts for the control loop, off the DWT cycle counter, kept as histograms in static RAM.
+With profiling off (the default), profileStart() and profileEnd() compile to nothing.
+Histogram bins are log-scaled, four to an octave, so a percentile read off them is good to within about 20%;
+the worst case is kept exactly.
+*/
+
+enum class ProfileStage { Read, Predict, Update, Output, Tick, Count };
+
+const int profileBins {64}; // Four per octave: up to 131071 cycles (1.3ms at 96MHz), then one overflow bin.
+
+struct StageProfile {
+    uint32_t samples;
+    uint32_t worst;
+    uint64_t total;
+    uint32_t histogram[profileBins + 1];
+};
+
+extern StageProfile stageProfiles[(int)ProfileStage::Count];
+extern StageProfile axisProfiles[MBED_CONF_APP_AXES]; // Everything one axis costs per tick, to see how many fit.
+
+void recordStage (ProfileStage stage, uint32_t cycles);
+void recordAxis (int axis, uint32_t cycles);
+void resetProfile ();
+void printProfile ();
+
+inline uint32_t profileStart () {
+    return MBED_CONF_APP_PROFILING ? cycleCount() : 0;
+}
+
+inline void profileEnd (ProfileStage stage, uint32_t start) {
+    if (MBED_CONF_APP_PROFILING) {
+        recordStage(stage, cycleCount() - start);
+    }
+}
+
+inline void profileAxis (int axis, uint32_t start) {
+    if (MBED_CONF_APP_PROFILING) {
+        recordAxis(axis, cycleCount() - start);
+    }
+}
@@ -0,0 +1,71 @@
+#include "safety.h"
+#include "board.h"
+#include "config.h"
+#include "controller.h"
+#include "flightrecorder.h"
+#include "motion.h"
+#include <atomic>
+#include <cstdio>
+
+SafetyStats safetyStats {};
+static std::atomic<bool> stalled {false};
+static bool started {false};
+static uint32_t lastKickUs {};
+
+static void onStall () {
+// From the ticker interrupt.
+    stopDacStream();
+    stalled.store(true, std::memory_order_release);
+}
+
+void startSafety () {
+    startWatchdog(MBED_CONF_APP_WATCHDOG_MS, MBED_CONF_APP_STALL_TICKS, onStall);
+    lastKickUs = clockUs();
+    started = true;
+}
+
+static void holdAxis (int axis) {
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    if (fixedStateCurrent(axis)) {
+        publishFixedState(axis);
+    }
+#endif
+    cancelMoves(axis);
+    axes.velocity[axis] = 0;
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    syncFixedFromFloat(axis);
+#endif
+}
+
+void serviceSafety () {
+    if (!started) {
+        return;
+    }
+    kickWatchdog();
+    uint32_t now = clockUs();
+    if (now - lastKickUs > safetyStats.worstKickGapUs) {
+        safetyStats.worstKickGapUs = now - lastKickUs;
+    }
+    lastKickUs = now;
+    if (stalled.exchange(false, std::memory_order_acquire)) {
+        ++safetyStats.stalls;
+        triggerFlightRecorder(RecorderTrigger::Stall, 0);
+        for (int axis = 0; axis < axisCount; ++axis) {
+            holdAxis(axis);
+        }
+    }
+}
+
+void resetSafetyStats () {
+// Also drops a stall that's been raised and not yet acted on: 'c' calls this straight after saveCalibration(), whose
+// sector erase holds the loop up for longer than stall-ticks, and that's expected rather than a stall to hold for.
+    stalled.store(false, std::memory_order_release);
+    safetyStats = SafetyStats {};
+    lastKickUs = clockUs();
+}
+
+void printSafetyStats () {
+    printf("safety: %lu stalls; longest between watchdog kicks %lu us (resets at %lu ms)\n",
+           (unsigned long)safetyStats.stalls, (unsigned long)safetyStats.worstKickGapUs,
+           (unsigned long)MBED_CONF_APP_WATCHDOG_MS);
+}
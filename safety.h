@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+What happens when the control thread stops keeping up. Deadline misses (a tick's work running past
+control-deadline-us) are only counted, by looptimer.cpp; the two layers here act:
+- A stall: the ticker interrupt finds stall-ticks ticks gone by without the control thread taking any. From the
+  interrupt it only stops any DAC stream where it is, so a streamed move can't carry on unwatched, and raises a flag.
+  The next tick the thread does get, before anything else, every axis has its moves cancelled and its velocity
+  zeroed: it holds where it is and goes back to complying from rest. The flight recorder gets a trigger too.
+- The hardware watchdog, kicked every tick. If the thread doesn't come back within watchdog-ms, the chip resets and
+  starts over (from the stored calibration). main() says so on the way back up.
+Both start with startSafety(), once startup calibration's done. With fixed-rate-loop off there's no ticker to notice a
+stall, so it's the watchdog alone.
+*/
+
+struct SafetyStats {
+    uint32_t stalls;
+    uint32_t worstKickGapUs; // The longest the watchdog went without a kick. Past watchdog-ms, it'd have reset.
+};
+
+extern SafetyStats safetyStats;
+
+void startSafety ();
+void serviceSafety (); // Once a tick, from waitForControlTick(), as it wakes.
+void resetSafetyStats (); // The stats, and any stall still pending. After anything that holds the loop up on purpose.
+void printSafetyStats ();
@@ -0,0 +1,336 @@
+/*
+Benchmarks for the control path, with a baseline to hold them to:
+
+    roborock-sim bench                                      print the numbers
+    roborock-sim bench --baseline tools/bench_baseline.txt  ...and fail if any got worse
+    roborock-sim bench --save my_baseline.txt               write them out as a new baseline
+
+Two kinds of number. The microbenchmarks are host nanoseconds per call of clamp(), specialSauce(),
+calculateFutureAUC(), comply(), coast(), fixtureForce(), recordFlight() and readInputs(), the best of several runs;
+they only mean something against a baseline saved on the same machine, which is why the checked-in baseline leaves
+them out. The latencies are from a push on the simulated load cell (and a pulse on fromMaster) to the controller
+noticing (and waking, the rod having been left idle), commanding the actuator, and the rod actually moving. They're
+in virtual time, so they're the same on any machine, and any change to them is a change in the controller.
+A microbenchmark that's worse than its baseline by more than the tolerance is a regression, and so is a latency
+that's any worse at all: each one gets flagged, and the exit status is 1. Metrics with no baseline are just printed.
+*/
+
+#include "sim.h"
+#include "board.h"
+#include "config.h"
+#include "controller.h"
+#include "fixtures.h"
+#include "flightrecorder.h"
+#include "idlemode.h"
+#include "looptimer.h"
+#include "masterinput.h"
+#include "motion.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Metric {
+    std::string name;
+    double value;
+    const char *unit;
+    bool exact; // Virtual time, so it doesn't get the tolerance.
+};
+
+const int benchCases {256};
+const int benchRepeats {7};
+volatile float sink;
+
+struct BenchInput {
+    float inScaled;
+    float inScaledPrior;
+    float velocity;
+};
+
+std::vector<BenchInput> benchInputs () {
+// Both signs of input and velocity, and slopes big and small, so every branch gets its share.
+    std::vector<BenchInput> inputs;
+    for (int i = 0; i < benchCases; ++i) {
+        float prior = (i % 17 - 8) / 40.0f;
+        inputs.push_back({prior + (i % 5 - 2) / 200.0f, prior, (i % 3 - 1) * tuning.maxSpeed[0] / 2});
+    }
+    return inputs;
+}
+
+template <typename Call>
+double nanosecondsPerCall (int iterations, Call call) {
+// The fastest of a few runs: anything slower than that was the host doing something else.
+    double best {1e30};
+    for (int repeat = 0; repeat < benchRepeats; ++repeat) {
+        auto started = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            call(i % benchCases);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        best = std::min(best, seconds * 1e9 / iterations);
+    }
+    return best;
+}
+
+void microbenchmarks (int iterations, std::vector<Metric> &metrics) {
+    resetControllerState();
+    simSetup(PlantConfig(), {});
+    std::vector<BenchInput> inputs = benchInputs();
+    auto load = [&](int i) {
+        axes.inScaled[0] = inputs[i].inScaled;
+        axes.inScaledPrior[0] = inputs[i].inScaledPrior;
+        axes.velocity[0] = inputs[i].velocity;
+    };
+    metrics.push_back({"clamp_ns", nanosecondsPerCall(iterations, [&](int i) {
+        sink = clamp(inputs[i].inScaled * 4, -1.0, 1.0);
+    }), "ns", false});
+    metrics.push_back({"specialSauce_ns", nanosecondsPerCall(iterations, [&](int i) {
+        axes.velocity[0] = inputs[i].velocity;
+        sink = specialSauce(0, inputs[i].inScaled);
+    }), "ns", false});
+    metrics.push_back({"calculateFutureAUC_ns", nanosecondsPerCall(iterations, [&](int i) {
+        load(i);
+        sink = calculateFutureAUC(0);
+    }), "ns", false});
+    metrics.push_back({"comply_ns", nanosecondsPerCall(iterations, [&](int i) {
+        load(i);
+        axes.command[0] = 0.5f; // So it's never pinned at a limit, which would skip work.
+        comply(0);
+    }), "ns", false});
+    // The same, with the model-predictive mode (mpc.h) doing the velocity instead of the predictor.
+    ComplianceMode compliance = tuning.compliance[0];
+    tuning.compliance[0] = ComplianceMode::Mpc;
+    metrics.push_back({"complyMpc_ns", nanosecondsPerCall(iterations, [&](int i) {
+        load(i);
+        axes.command[0] = 0.5f;
+        comply(0);
+    }), "ns", false});
+    tuning.compliance[0] = compliance;
+    // What an idle tick does instead of comply(); see idlemode.h.
+    metrics.push_back({"coast_ns", nanosecondsPerCall(iterations, [&](int i) {
+        load(i);
+        axes.command[0] = 0.5f;
+        coast(0);
+    }), "ns", false});
+    // A full set of fixtures, though with the table it'd cost the same with one.
+    const Fixture fixtures[fixtureLimit] {
+        {FixtureKind::Spring, 0, 1, 0.5f, 0.5f}, {FixtureKind::Wall, 0, 0.1f, 4, 0}, {FixtureKind::Wall, 0.9f, 1, 4, 0},
+        {FixtureKind::Detent, 0.2f, 0.3f, 0.05f, 0}, {FixtureKind::Detent, 0.45f, 0.55f, 0.05f, 0},
+        {FixtureKind::Detent, 0.7f, 0.8f, 0.05f, 0}, {FixtureKind::Viscous, 0, 0.2f, 0.2f, 0},
+        {FixtureKind::Viscous, 0.8f, 1, 0.2f, 0},
+    };
+    loadFixtures(0, fixtures, fixtureLimit);
+    while (fixturesPending(0)) {
+        buildFixtures();
+    }
+    metrics.push_back({"fixtureForce_ns", nanosecondsPerCall(iterations, [&](int i) {
+        axes.command[0] = (i + 0.5f) / benchCases;
+        axes.velocity[0] = inputs[i].velocity;
+        sink = fixtureForce(0);
+    }), "ns", false});
+    resetFixtures();
+    // Every tick pays this, in waitForControlTick().
+    metrics.push_back({"recordFlight_ns", nanosecondsPerCall(iterations, [&](int i) {
+        load(i);
+        recordFlight();
+    }), "ns", false});
+    resetFlightRecorder();
+    // Virtual time stands still in here, so readForce() hands back the same conversion every call; this is the
+    // scaling and clamping, not the plant.
+    axes.inMin[0] = 0.2f;
+    axes.inMax[0] = 0.8f;
+    axes.inZero[0] = 0.5f;
+    metrics.push_back({"readInputs_ns", nanosecondsPerCall(iterations, [&](int) {
+        sink = readInputs(0);
+    }), "ns", false});
+}
+
+void latencies (std::vector<Metric> &metrics) {
+/*
+Sets the calibration up directly instead of sweeping, parks the rod mid-range, then pushes on it and, later,
+pulses fromMaster off the tick boundary. Everything's timed from the event to the end of the first tick that shows it.
+*/
+    const double pushAt {1.0};
+    const double pulseAt {1.5003};
+    const float dacStep {1.0f / 1023};
+    resetControllerState();
+    std::vector<SimEvent> events {
+        {pushAt, SimEvent::Push, 0.2},
+        {pushAt + 0.2, SimEvent::Push, 0},
+        {pulseAt, SimEvent::Master, 1},
+        {pulseAt + 0.0004, SimEvent::Master, 0},
+    };
+    simSetup(PlantConfig(), events);
+    boardInit();
+    startControlLoop(MBED_CONF_APP_CONTROL_PERIOD_US);
+    axes.inZero[0] = measureZero(0);
+    axes.inMin[0] = axes.inZero[0] - tuning.inRange[0];
+    axes.inMax[0] = axes.inZero[0] + tuning.inRange[0];
+    move(0, 0.5, false);
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    syncFixedFromFloat(0);
+#endif
+    resetMasterInput();
+    resetIdleMode();
+    double sensed {-1};
+    double woke {-1};
+    uint32_t wakesBefore {0};
+    double commanded {-1};
+    double moved {-1};
+    float commandBefore {0};
+    double positionBefore {0};
+    while (simSeconds() < pulseAt + 0.1) {
+        bool pushed = simSeconds() >= pushAt;
+        if (!pushed) {
+            commandBefore = axes.command[0];
+            positionBefore = simPlant(0).position();
+            wakesBefore = idleStats.wakes;
+        }
+        controlStep();
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+        publishFixedState(0);
+#endif
+        double after = simSeconds() - pushAt;
+        if (pushed && woke < 0 && idleStats.wakes > wakesBefore) {
+            woke = after;
+        }
+        if (pushed && sensed < 0 && std::fabs(axes.inScaled[0]) > 0.05f) {
+            sensed = after;
+        }
+        if (pushed && commanded < 0 && std::fabs(axes.command[0] - commandBefore) > dacStep) {
+            commanded = after;
+        }
+        waitForControlTick();
+        // The rod's between ticks, so it's checked once the plant's had the tick to move.
+        if (pushed && moved < 0 && std::fabs(simPlant(0).position() - positionBefore) > dacStep) {
+            moved = simSeconds() - pushAt;
+        }
+    }
+    // Never seeing it at all is the worst regression there is, so it reads as one.
+    auto us = [](double seconds) { return seconds < 0 ? 1e9 : seconds * 1e6; };
+    metrics.push_back({"push_to_sensed_us", us(sensed), "us", true});
+    // The rod's been left alone since it parked, so the push has to wake it first.
+    if (idleScheduling) {
+        metrics.push_back({"push_to_wake_us", us(woke), "us", true});
+    }
+    metrics.push_back({"push_to_command_us", us(commanded), "us", true});
+    metrics.push_back({"push_to_motion_us", us(moved), "us", true});
+    double edgeUs = masterInputStats.latencySamples > 0
+        ? (double)masterInputStats.latencyTotalUs / masterInputStats.latencySamples : 1e9;
+    metrics.push_back({"master_edge_to_actuator_us", edgeUs, "us", true});
+}
+
+bool loadBaseline (const char *path, std::vector<Metric> &baseline) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char name[128];
+        double value;
+        if (line[0] != '#' && sscanf(line, "%127s %lf", name, &value) == 2) {
+            baseline.push_back({name, value, "", false});
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+void usage () {
+    printf(
+        "usage: roborock-sim bench [options]\n"
+        "  --baseline FILE     fail if anything's worse than in FILE by more than the tolerance\n"
+        "  --tolerance F       how much worse a microbenchmark can get, as a fraction (default 0.25)\n"
+        "  --save FILE         write this run's numbers to FILE, in the baseline format\n"
+        "  --iterations N      calls per microbenchmark run (default 2000000)\n"
+        "  --latency-only      skip the microbenchmarks\n");
+}
+
+}
+
+int benchMain (int argc, char **argv) {
+    const char *baselinePath {nullptr};
+    const char *savePath {nullptr};
+    double tolerance {0.25};
+    int iterations {2000000};
+    bool latencyOnly {false};
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--latency-only") == 0) {
+            latencyOnly = true;
+            continue;
+        }
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (value == nullptr) {
+            usage();
+            return 1;
+        }
+        if (strcmp(arg, "--baseline") == 0) {
+            baselinePath = value;
+        }
+        else if (strcmp(arg, "--tolerance") == 0) {
+            tolerance = atof(value);
+        }
+        else if (strcmp(arg, "--save") == 0) {
+            savePath = value;
+        }
+        else if (strcmp(arg, "--iterations") == 0) {
+            iterations = std::max(benchCases, atoi(value));
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+    std::vector<Metric> baseline;
+    if (baselinePath != nullptr && !loadBaseline(baselinePath, baseline)) {
+        return 1;
+    }
+
+    std::vector<Metric> metrics;
+    if (!latencyOnly) {
+        microbenchmarks(iterations, metrics);
+    }
+    latencies(metrics);
+
+    int regressions {0};
+    for (const Metric &metric : metrics) {
+        auto was = std::find_if(baseline.begin(), baseline.end(), [&](const Metric &b) { return b.name == metric.name; });
+        if (was == baseline.end()) {
+            printf("%-28s %10.1f %s\n", metric.name.c_str(), metric.value, metric.unit);
+            continue;
+        }
+        double change = was->value > 0 ? metric.value / was->value - 1 : metric.value > 0 ? 1e9 : 0;
+        bool regressed = change > (metric.exact ? 1e-9 : tolerance);
+        printf("%-28s %10.1f %s  (baseline %.1f, %+.1f%%)%s\n", metric.name.c_str(), metric.value, metric.unit,
+               was->value, change * 100, regressed ? "  <-- REGRESSION" : "");
+        regressions += regressed;
+    }
+    if (savePath != nullptr) {
+        FILE *file = fopen(savePath, "w");
+        if (file == nullptr) {
+            perror(savePath);
+            return 1;
+        }
+        fprintf(file, "# roborock-sim bench --save; name value\n");
+        for (const Metric &metric : metrics) {
+            fprintf(file, "%s %.1f\n", metric.name.c_str(), metric.value);
+        }
+        fclose(file);
+    }
+    if (regressions > 0) {
+        fflush(stdout);
+        fprintf(stderr, "\n*** bench FAILED: %d metric%s worse than in %s ***\n", regressions,
+                regressions == 1 ? "" : "s", baselinePath);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,379 @@
+#include "board.h"
+#include "config.h"
+#include "sim.h"
+#include "spscring.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+const int axes {MBED_CONF_APP_AXES};
+Plant plants[axes];
+std::vector<SimEvent> schedule;
+size_t nextEvent {0};
+bool master {false};
+SpscRing<MasterEdge, 32> masterEdges;
+bool masterEdgeLost {false};
+uint64_t nowUs {0};
+uint64_t sampledAtUs[axes];
+float samples[axes];
+std::vector<uint16_t> stream(MBED_CONF_APP_DAC_STREAM_SIZE);
+uint32_t streamCount {0};
+uint32_t streamPlayed {0};
+uint64_t streamStartUs {0};
+uint32_t streamRateHz {1};
+bool streaming {false};
+void (*backgroundTask)() {nullptr};
+uint32_t backgroundPeriodUs {0};
+uint64_t nextBackgroundUs {0};
+FILE *telemetryOutput {nullptr};
+std::vector<uint8_t> flash;
+const char *flashPath {nullptr};
+uint32_t tickerPeriodUs {0};
+uint64_t nextTickUs {0};
+uint32_t stallTicks {UINT32_MAX};
+void (*stallHandler)() {nullptr};
+SimLoopStats loopStats;
+std::chrono::steady_clock::time_point awokeAt;
+bool awake {false};
+
+void applyEvent (const SimEvent &event) {
+    switch (event.kind) {
+        case SimEvent::Wall:
+            plants[0].setWall(event.value >= 0, event.value);
+            break;
+        case SimEvent::Push:
+            plants[0].setExternalForce(event.value);
+            break;
+        case SimEvent::Master:
+            if (master != (event.value != 0)) {
+                master = !master;
+                if (!masterEdges.push(MasterEdge {(uint32_t)nowUs, master})) {
+                    masterEdgeLost = true;
+                }
+            }
+            break;
+    }
+}
+
+void goToSleep () {
+    // Whatever happened since the last wake-up was controller code; that's the part worth timing.
+    if (awake) {
+        double spent = std::chrono::duration<double>(std::chrono::steady_clock::now() - awokeAt).count();
+        loopStats.controllerSeconds += spent;
+        loopStats.worstTickSeconds = std::max(loopStats.worstTickSeconds, spent);
+        ++loopStats.ticks;
+    }
+}
+
+void wakeUp () {
+    awokeAt = std::chrono::steady_clock::now();
+    awake = true;
+}
+
+uint64_t streamSampleUs (uint32_t index) {
+// Sample 0 goes out one period after the stream starts, like the DAC's counter running out for the first time.
+    return streamStartUs + (uint64_t)(index + 1) * 1000000 / streamRateHz;
+}
+
+void advanceTo (uint64_t us) {
+/*
+Everything that happens on its own schedule (scenario events, DAC streams, the background task) gets run at
+its moment as virtual time passes. Only ever called while the controller is "asleep", which is also the only
+time a lower-priority task would get the CPU on target.
+*/
+    while (nowUs < us) {
+        uint64_t until = us;
+        if (backgroundTask != nullptr) {
+            if (nextBackgroundUs <= nowUs) {
+                nextBackgroundUs += backgroundPeriodUs;
+                backgroundTask();
+                continue;
+            }
+            until = std::min(until, nextBackgroundUs);
+        }
+        if (streaming) {
+            if (streamPlayed >= streamCount) {
+                streaming = false;
+                continue;
+            }
+            uint64_t sampleUs = streamSampleUs(streamPlayed);
+            if (sampleUs <= nowUs) {
+                plants[0].setSetpoint(stream[streamPlayed++] / 65535.0);
+                continue;
+            }
+            until = std::min(until, sampleUs);
+        }
+        if (nextEvent < schedule.size()) {
+            uint64_t eventUs = (uint64_t)(schedule[nextEvent].time * 1e6);
+            if (eventUs <= nowUs) {
+                applyEvent(schedule[nextEvent++]);
+                continue;
+            }
+            until = std::min(until, eventUs);
+        }
+        for (Plant &plant : plants) {
+            plant.advance((until - nowUs) * 1e-6);
+        }
+        nowUs = until;
+    }
+}
+
+}
+
+void simSetup (const PlantConfig &config, const std::vector<SimEvent> &events) {
+    for (int axis = 0; axis < axes; ++axis) {
+        PlantConfig axisConfig = config;
+        axisConfig.seed += axis;
+        plants[axis] = Plant(axisConfig);
+        if (axis > 0) {
+            // Scenario events only script the first axis; the rest get a hand that calibrates itself.
+            plants[axis].setHand(0.3, 0.85);
+        }
+        sampledAtUs[axis] = UINT64_MAX;
+    }
+    schedule = events;
+    std::stable_sort(schedule.begin(), schedule.end(), [](const SimEvent &a, const SimEvent &b) { return a.time < b.time; });
+    nextEvent = 0;
+    master = false;
+    MasterEdge stale;
+    while (masterEdges.pop(stale)) {
+    }
+    masterEdgeLost = false;
+    nowUs = 0;
+    streaming = false;
+    streamCount = streamPlayed = 0;
+    backgroundTask = nullptr;
+    tickerPeriodUs = 0;
+    stallHandler = nullptr;
+    loopStats = SimLoopStats();
+    awake = false;
+    // Anything at time zero is already so at power-up.
+    while (nextEvent < schedule.size() && schedule[nextEvent].time <= 0) {
+        applyEvent(schedule[nextEvent++]);
+    }
+}
+
+Plant &simPlant (int axis) {
+    return plants[axis];
+}
+
+double simSeconds () {
+    return nowUs * 1e-6;
+}
+
+void simSetTelemetryOutput (FILE *file) {
+    telemetryOutput = file;
+}
+
+void simSetFlashFile (const char *path) {
+    flashPath = path;
+    flash.clear();
+    FILE *file = fopen(path, "rb");
+    if (file != nullptr) {
+        int c;
+        while ((c = fgetc(file)) != EOF) {
+            flash.push_back((uint8_t)c);
+        }
+        fclose(file);
+    }
+}
+
+const SimLoopStats &simLoopStats () {
+    return loopStats;
+}
+
+void boardInit () {
+}
+
+float readForce (int axis) {
+    // Reads at the same instant are the same conversion, so readForce() and readForceRaw() agree within a tick.
+    if (sampledAtUs[axis] != nowUs) {
+        Plant &plant = plants[axis];
+#if MBED_CONF_APP_ADC_DMA_BURST
+        // Burst mode averages the newest handful of conversions. They're microseconds apart, so the plant hasn't
+        // moved between them; only the noise differs.
+        double sum {0};
+        for (int i = 0; i < MBED_CONF_APP_ADC_OVERSAMPLE; ++i) {
+            sum += plant.sampleVoltage();
+        }
+        samples[axis] = sum / MBED_CONF_APP_ADC_OVERSAMPLE;
+#else
+        samples[axis] = plant.sampleVoltage();
+#endif
+        sampledAtUs[axis] = nowUs;
+    }
+    return samples[axis];
+}
+
+uint16_t readForceRaw (int axis) {
+    return (uint16_t)std::lround(readForce(axis) * 65535);
+}
+
+void writeActuator (int axis, float position) {
+    plants[axis].setSetpoint(position);
+}
+
+void writeActuatorRaw (int axis, uint16_t position) {
+    plants[axis].setSetpoint(position / 65535.0);
+}
+
+bool readMaster () {
+    return master;
+}
+
+bool popMasterEdge (MasterEdge &edge) {
+    return masterEdges.pop(edge);
+}
+
+bool masterEdgesLost () {
+    bool lost = masterEdgeLost;
+    masterEdgeLost = false;
+    return lost;
+}
+
+uint64_t clockMs () {
+    return nowUs / 1000;
+}
+
+uint32_t clockUs () {
+    return (uint32_t)nowUs;
+}
+
+void sleepMs (uint32_t ms) {
+    goToSleep();
+    advanceTo(nowUs + ms * 1000ull);
+    wakeUp();
+}
+
+void startTicker (uint32_t periodUs) {
+    tickerPeriodUs = periodUs;
+    nextTickUs = nowUs + periodUs;
+}
+
+uint32_t waitForTicker () {
+/*
+Controller code takes no virtual time, so the simulated loop never overruns on its own. Anything that
+sleeps between ticks (or the ticker having been started long ago) shows up as missed ticks, same as on target.
+The stall check the ticker interrupt makes on target happens here, on the way out, which is still before the
+caller gets to do anything with the tick.
+*/
+    goToSleep();
+    uint32_t elapsed {0};
+    if (nextTickUs <= nowUs) {
+        elapsed = (uint32_t)((nowUs - nextTickUs) / tickerPeriodUs + 1);
+        nextTickUs += (uint64_t)elapsed * tickerPeriodUs;
+    }
+    else {
+        advanceTo(nextTickUs);
+        nextTickUs += tickerPeriodUs;
+        elapsed = 1;
+    }
+    if (stallHandler != nullptr && elapsed > stallTicks) {
+        stallHandler();
+    }
+    wakeUp();
+    return elapsed;
+}
+
+uint32_t dacStreamCapacity () {
+    return (uint32_t)stream.size();
+}
+
+void setDacStreamSample (uint32_t index, uint16_t position) {
+    // Same 10 bits the real DAC keeps.
+    stream[index] = position & 0xFFC0;
+}
+
+void startDacStream (uint32_t count, uint32_t rateHz) {
+    streamCount = count;
+    streamPlayed = 0;
+    streamStartUs = nowUs;
+    streamRateHz = rateHz > 0 ? rateHz : 1;
+    streaming = true;
+}
+
+uint32_t dacStreamProgress () {
+    return streaming ? streamPlayed : streamCount;
+}
+
+void stopDacStream () {
+    if (streaming) {
+        streamCount = streamPlayed;
+        streaming = false;
+    }
+}
+
+uint32_t cycleCountHz () {
+    return 1000000000;
+}
+
+uint32_t cycleCount () {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void startBackgroundTask (void (*task)(), uint32_t periodMs) {
+    backgroundTask = task;
+    backgroundPeriodUs = periodMs * 1000;
+    nextBackgroundUs = nowUs + backgroundPeriodUs;
+}
+
+void startControlThread (void (*loop)()) {
+    // No threads here: the simulator's own loop stands in for it, so this just runs it.
+    loop();
+}
+
+void startWatchdog (uint32_t, uint32_t ticks, void (*onStall)()) {
+    // Nothing resets the simulator; safety.cpp's longest gap between kicks says whether the chip would have.
+    stallTicks = ticks;
+    stallHandler = onStall;
+}
+
+void kickWatchdog () {
+}
+
+bool resetByWatchdog () {
+    return false;
+}
+
+int threadStacks (ThreadStack *, int) {
+    return 0;
+}
+
+void writeTelemetry (const uint8_t *bytes, uint32_t length) {
+    if (telemetryOutput != nullptr) {
+        fwrite(bytes, 1, length, telemetryOutput);
+    }
+}
+
+int readConsole () {
+    return -1;
+}
+
+bool loadCalibrationRecord (void *record, uint32_t length) {
+    // Erased flash reads as all ones, which no record's checksum matches.
+    memset(record, 0xFF, length);
+    if (!flash.empty()) {
+        memcpy(record, flash.data(), std::min<size_t>(length, flash.size()));
+    }
+    return true;
+}
+
+bool saveCalibrationRecord (const void *record, uint32_t length) {
+    flash.assign((const uint8_t *)record, (const uint8_t *)record + length);
+    if (flashPath != nullptr) {
+        FILE *file = fopen(flashPath, "wb");
+        if (file == nullptr || fwrite(record, 1, length, file) != length) {
+            if (file != nullptr) {
+                fclose(file);
+            }
+            return false;
+        }
+        fclose(file);
+    }
+    return true;
+}
@@ -0,0 +1,137 @@
+#include "sim.h"
+#include "board.h"
+#include "config.h"
+#include "controller.h"
+#include "idlemode.h"
+#include "looptimer.h"
+#include "motion.h"
+#include "mpcgains.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+/*
+Runs the predictor and the model-predictive mode (mpc.h) through the same pushes on the same plant:
+- Jitter at rest, as RMS of the command's tick-to-tick change in DAC steps, same as --compare-estimators.
+- Latency: how long after a push starts the command has moved one DAC step, and the rod itself has.
+- Tracking: RMS of velocity's difference from the virtual mass-damper that inertia and slickness describe, driven by
+  the plant's true (noise-free) force and held to maxSpeed, as a fraction of maxSpeed. That model is the MPC's
+  reference by construction, so it's the predictor being measured against what the tuning says it should feel like.
+The pushes come in pairs, one to start the rod and an opposite one to stop it, since with slickness at 0.999 a
+rod that's been started goes most of the way to a limit on its own.
+- At the limit: a long push runs the rod into outMax. Speed on arrival (as a fraction of maxSpeed), and whether it
+  got there.
+*/
+
+namespace {
+
+struct ModeResult {
+    double jitterSteps;
+    double pushToCommandMs;
+    double pushToMotionMs;
+    double trackingError;
+    double limitSpeed;
+    bool reachedLimit;
+};
+
+ModeResult run (const PlantConfig &config) {
+// Calibration's set up directly, like bench does, so only the compliance mode differs between runs.
+    const double pushAt {4.0};
+    const double holdAt {7.0}; // The push into the limit. Tracking's only scored before it: the model has no limits.
+    const double end {9.0};
+    const float dacStep {1.0f / 1023};
+    ComplianceMode mode = tuning.compliance[0];
+    resetControllerState();
+    tuning.compliance[0] = mode;
+    simSetup(config, {
+        {pushAt, SimEvent::Push, 0.2}, {pushAt + 0.1, SimEvent::Push, -0.2}, {pushAt + 0.2, SimEvent::Push, 0},
+        {pushAt + 1, SimEvent::Push, -0.2}, {pushAt + 1.1, SimEvent::Push, 0.2}, {pushAt + 1.2, SimEvent::Push, 0},
+        {holdAt, SimEvent::Push, 0.3}, {end, SimEvent::Push, 0},
+    });
+    boardInit();
+    startControlLoop(MBED_CONF_APP_CONTROL_PERIOD_US);
+    axes.inZero[0] = measureZero(0);
+    axes.inMin[0] = axes.inZero[0] - tuning.inRange[0];
+    axes.inMax[0] = axes.inZero[0] + tuning.inRange[0];
+    axes.outMin[0] = 0.1f;
+    axes.outMax[0] = 0.9f;
+    move(0, 0.5, false);
+    resetForceEstimator(0);
+    idleFor(500);
+    const float maxSpeed {tuning.maxSpeed[0]};
+    double jitterSquares {0};
+    long jitterTicks {0};
+    double trackingSquares {0};
+    long trackingTicks {0};
+    ModeResult result {0, -1, -1, 0, 0, false};
+    float before {axes.command[0]};
+    double rodBefore {0};
+    double model {0};
+    while (simSeconds() < end) {
+        float prior = axes.command[0];
+        controlStep();
+        double now = simSeconds();
+        if (now < pushAt) {
+            double change = (axes.command[0] - prior) / dacStep;
+            jitterSquares += change * change;
+            ++jitterTicks;
+            before = axes.command[0];
+            rodBefore = simPlant(0).position();
+            model = axes.velocity[0];
+        }
+        else {
+            if (result.pushToCommandMs < 0 && std::fabs(axes.command[0] - before) > dacStep) {
+                result.pushToCommandMs = (now - pushAt) * 1e3;
+            }
+            if (result.pushToMotionMs < 0 && std::fabs(simPlant(0).position() - rodBefore) > dacStep) {
+                result.pushToMotionMs = (now - pushAt) * 1e3;
+            }
+            if (now < holdAt) {
+                double force = simPlant(0).cellForce();
+                model = model * tuning.slickness[0] + force * mpcForceGain / tuning.inertia[0];
+                model = std::min(std::max(model, (double)-maxSpeed), (double)maxSpeed);
+                double error = (axes.velocity[0] - model) / maxSpeed;
+                trackingSquares += error * error;
+                ++trackingTicks;
+            }
+            else if (!result.reachedLimit && axes.command[0] >= axes.outMax[0]) {
+                // Velocity's already been zeroed by now, so it's the last step that says how fast it arrived.
+                result.reachedLimit = true;
+                result.limitSpeed = (axes.command[0] - prior) / maxSpeed;
+            }
+        }
+        waitForControlTick();
+    }
+    result.jitterSteps = std::sqrt(jitterSquares / std::max(jitterTicks, 1L));
+    result.trackingError = std::sqrt(trackingSquares / std::max(trackingTicks, 1L));
+    return result;
+}
+
+}
+
+void compareComplianceModes (const PlantConfig &config) {
+    ComplianceMode saved = tuning.compliance[0];
+    // Coasting would hide the jitter at rest, and skip ticks of one mode that the other doesn't.
+    bool idleWas = idleScheduling;
+    idleScheduling = false;
+    printf("mode        jitter (DAC steps)  push to command  push to motion  tracking (of maxSpeed)  into limit at\n");
+    for (ComplianceMode mode : {ComplianceMode::Predictor, ComplianceMode::Mpc}) {
+        tuning.compliance[0] = mode;
+        ModeResult result = run(config);
+        printf("%-11s %18.3f  %12.0f ms  %11.0f ms  %22.3f  ", complianceModeName(mode), result.jitterSteps,
+               result.pushToCommandMs, result.pushToMotionMs, result.trackingError);
+        if (result.reachedLimit) {
+            printf("%.2f maxSpeed\n", result.limitSpeed);
+        }
+        else {
+            printf("(didn't get there)\n");
+        }
+    }
+    printf("(MPC gains: effort weight %g, horizon %d of", (double)mpcEffortWeight, tuning.predictXCyclesAhead[0]);
+    for (const MpcGains &gains : mpcGains) {
+        printf(" %d", gains.horizon);
+    }
+    printf("; see tools/mpc_gains.py)\n");
+    tuning.compliance[0] = saved;
+    idleScheduling = idleWas;
+}
@@ -0,0 +1,120 @@
+#include "sim.h"
+#include "board.h"
+#include "controller.h"
+#include "fixtures.h"
+#include "flightrecorder.h"
+#include "idlemode.h"
+#include "looptimer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+/*
+Runs the float and fixed-point engines side by side on the same ADC readings. The float engine's actuator
+write lands last each tick, so it's the one driving the plant; the fixed engine just follows along. Only the first
+axis is compared; any others are left at their reset state.
+*/
+
+namespace {
+
+struct Snapshot {
+    float inScaled, inScaledPrior, velocity, command, anticipatedAUC;
+};
+
+Snapshot takeSnapshot () {
+    return {axes.inScaled[0], axes.inScaledPrior[0], axes.velocity[0], axes.command[0], axes.anticipatedAUC[0]};
+}
+
+void restore (const Snapshot &snapshot) {
+    axes.inScaled[0] = snapshot.inScaled;
+    axes.inScaledPrior[0] = snapshot.inScaledPrior;
+    axes.velocity[0] = snapshot.velocity;
+    axes.command[0] = snapshot.command;
+    axes.anticipatedAUC[0] = snapshot.anticipatedAUC;
+}
+
+Snapshot fixedSnapshot () {
+// The fixed engine's state as floats, without disturbing the float engine's.
+    Snapshot floats = takeSnapshot();
+    publishFixedState(0);
+    Snapshot fixed = takeSnapshot();
+    restore(floats);
+    return fixed;
+}
+
+struct Errors {
+    double command {0};
+    double velocity {0};
+    double auc {0};
+    double commandSum {0};
+    long ticks {0};
+};
+
+Errors run (const PlantConfig &config, const std::vector<SimEvent> &events, double seconds, bool resyncEachTick) {
+    resetControllerState();
+    simSetup(config, events);
+    startControlLoop(1000);
+    calibrate(0);
+    syncFixedFromFloat(0);
+    Errors errors;
+    while (simSeconds() < seconds) {
+        if (resyncEachTick) {
+            syncFixedFromFloat(0);
+        }
+        // The scenario's fromMaster edges land on tick boundaries, so this is the same push controlStep() works out.
+        controlStepFixed(0, readMaster() ? -q30One / 2 : 0);
+        controlStep();
+        Snapshot fixed = fixedSnapshot();
+        Snapshot floats = takeSnapshot();
+        double commandError = std::fabs(fixed.command - floats.command);
+        errors.command = std::max(errors.command, commandError);
+        // Right at a limit, one engine can land exactly on it (and zero its velocity) while the other is a hair short.
+        float outMin {axes.outMin[0]};
+        float outMax {axes.outMax[0]};
+        bool pinned = floats.command >= outMax || floats.command <= outMin || fixed.command >= outMax || fixed.command <= outMin;
+        if (!pinned) {
+            errors.velocity = std::max(errors.velocity, (double)std::fabs(fixed.velocity - floats.velocity));
+        }
+        errors.auc = std::max(errors.auc, (double)std::fabs(fixed.anticipatedAUC - floats.anticipatedAUC));
+        errors.commandSum += commandError;
+        ++errors.ticks;
+        waitForControlTick();
+    }
+    return errors;
+}
+
+}
+
+void resetControllerState () {
+    for (int axis = 0; axis < axisCount; ++axis) {
+        axes.inZero[axis] = axes.inMin[axis] = axes.inMax[axis] = 0;
+        axes.inScaled[axis] = axes.inScaledPrior[axis] = 0;
+        axes.outMin[axis] = 0;
+        axes.outMax[axis] = 1;
+        axes.velocity[axis] = 0;
+        axes.command[axis] = 0;
+        axes.anticipatedAUC[axis] = 0;
+        resetForceEstimator(axis);
+    }
+    resetIdleMode();
+    resetFixtures();
+    resetFlightRecorder();
+}
+
+bool compareFixedEngine (const PlantConfig &config, const std::vector<SimEvent> &events, double seconds) {
+    // Both engines step the same axis each tick, and only one of them would get a given skip; it's the math being compared.
+    bool idleWas = idleScheduling;
+    idleScheduling = false;
+    Errors step = run(config, events, seconds, true);
+    printf("one tick from the same state: worst |command| error %.3g, |velocity| %.3g (off the limits), |AUC| %.3g over %ld ticks\n",
+           step.command, step.velocity, step.auc, step.ticks);
+    Errors drift = run(config, events, seconds, false);
+    printf("free-running: worst |command| error %.3g (mean %.3g), |velocity| %.3g\n", drift.command,
+           drift.commandSum / std::max(drift.ticks, 1L), drift.velocity);
+    // One DAC step is 1/1023; a single tick shouldn't come anywhere close to that.
+    printf("(one 10-bit DAC step is %.3g)\n", 1.0 / 1023);
+    compareEngineCost();
+    compareTuningCost();
+    idleScheduling = idleWas;
+    return step.command < 1.0 / 1023 / 16;
+}
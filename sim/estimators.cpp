@@ -0,0 +1,135 @@
+#include "sim.h"
+#include "board.h"
+#include "config.h"
+#include "controller.h"
+#include "idlemode.h"
+#include "looptimer.h"
+#include "motion.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+/*
+Puts each force-rate estimator (estimator.h) through the same measurements:
+- Phase lag: a clean sine goes straight into inScaled, and the rate estimate is compared with the sine's true
+  derivative, as a delay in milliseconds. The two-sample difference should come out at half a tick.
+- Rate noise: the plant's ADC noise on its own, and the RMS of the rate that makes.
+- Actuator jitter: the whole loop, plant and all, with the rod left alone. RMS of the command's tick-to-tick change,
+  in DAC steps: this is the noise that ends up on toActuator.
+- Push response: how long after a push the command has moved one DAC step, for what the smoothing costs in feel.
+*/
+
+namespace {
+
+const double pi {3.14159265358979};
+
+struct SineResponse {
+    double lagMs;
+    double gain; // Of the rate estimate, against the true derivative.
+};
+
+SineResponse sineResponse (double hz) {
+    const double tickSeconds {1e-3};
+    const double amplitude {0.2};
+    const int settle {2000};
+    const int ticks = settle + (int)std::lround(20 / (hz * tickSeconds)); // Twenty whole cycles after settling.
+    double inPhase {0};
+    double quadrature {0};
+    axes.inScaled[0] = 0;
+    resetForceEstimator(0);
+    for (int i = 1; i <= ticks; ++i) {
+        double angle = 2 * pi * hz * i * tickSeconds;
+        axes.inScaledPrior[0] = axes.inScaled[0];
+        axes.inScaled[0] = (float)(amplitude * std::sin(angle));
+        estimateForceRate(0);
+        if (i > settle) {
+            // The true derivative goes as cos(angle); project the estimate onto it and onto sin(angle).
+            inPhase += forceRate(0) * std::cos(angle);
+            quadrature += forceRate(0) * std::sin(angle);
+        }
+    }
+    double phase = std::atan2(quadrature, inPhase); // How far behind cos(angle) it is.
+    double perTick = amplitude * 2 * pi * hz * tickSeconds;
+    double measured = 2 * std::hypot(inPhase, quadrature) / (ticks - settle);
+    return {phase / (2 * pi * hz) * 1e3, measured / perTick};
+}
+
+double rateNoise (const PlantConfig &config) {
+    std::mt19937 rng(3);
+    std::normal_distribution<double> noise(0, config.noise / config.voltsPerForce);
+    const int ticks {20000};
+    double sumSquares {0};
+    axes.inScaled[0] = 0;
+    resetForceEstimator(0);
+    for (int i = 0; i < ticks; ++i) {
+        axes.inScaledPrior[0] = axes.inScaled[0];
+        axes.inScaled[0] = (float)noise(rng);
+        estimateForceRate(0);
+        sumSquares += forceRate(0) * forceRate(0);
+    }
+    return std::sqrt(sumSquares / ticks);
+}
+
+struct LoopResult {
+    double jitterSteps;
+    double pushMs;
+};
+
+LoopResult closedLoop (const PlantConfig &config) {
+// Calibration's set up directly, like bench does, so only the estimator differs between runs.
+    const double pushAt {4.0};
+    const float dacStep {1.0f / 1023};
+    ForceEstimator estimator = tuning.estimator[0];
+    resetControllerState();
+    tuning.estimator[0] = estimator;
+    simSetup(config, {{pushAt, SimEvent::Push, 0.2}, {pushAt + 0.3, SimEvent::Push, 0}});
+    boardInit();
+    startControlLoop(MBED_CONF_APP_CONTROL_PERIOD_US);
+    axes.inZero[0] = measureZero(0);
+    axes.inMin[0] = axes.inZero[0] - tuning.inRange[0];
+    axes.inMax[0] = axes.inZero[0] + tuning.inRange[0];
+    move(0, 0.5, false);
+    resetForceEstimator(0);
+    idleFor(500);
+    double sumSquares {0};
+    long ticks {0};
+    double pushMs {-1};
+    float before {axes.command[0]};
+    while (simSeconds() < pushAt + 0.3) {
+        float prior = axes.command[0];
+        controlStep();
+        if (simSeconds() < pushAt) {
+            double change = (axes.command[0] - prior) / dacStep;
+            sumSquares += change * change;
+            ++ticks;
+            before = axes.command[0];
+        }
+        else if (pushMs < 0 && std::fabs(axes.command[0] - before) > dacStep) {
+            pushMs = (simSeconds() - pushAt) * 1e3;
+        }
+        waitForControlTick();
+    }
+    return {std::sqrt(sumSquares / std::max(ticks, 1L)), pushMs};
+}
+
+}
+
+void compareEstimators (const PlantConfig &config) {
+    ForceEstimator saved = tuning.estimator[0];
+    // The jitter at rest is the point, so none of it gets skipped.
+    bool idleWas = idleScheduling;
+    idleScheduling = false;
+    const ForceEstimator estimators[] {ForceEstimator::TwoSample, ForceEstimator::AlphaBeta, ForceEstimator::SavitzkyGolay};
+    printf("estimator        lag@2Hz  lag@10Hz  gain@10Hz  rate noise  jitter (DAC steps)  push to command\n");
+    for (ForceEstimator estimator : estimators) {
+        tuning.estimator[0] = estimator;
+        SineResponse slow = sineResponse(2);
+        SineResponse fast = sineResponse(10);
+        double noise = rateNoise(config);
+        LoopResult loop = closedLoop(config);
+        printf("%-16s %5.2f ms  %5.2f ms  %9.3f  %10.5f  %18.3f  %12.0f ms\n", estimatorName(estimator), slow.lagMs,
+               fast.lagMs, fast.gain, noise, loop.jitterSteps, loop.pushMs);
+    }
+    tuning.estimator[0] = saved;
+    idleScheduling = idleWas;
+}
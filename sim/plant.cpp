@@ -0,0 +1,83 @@
+#include "plant.h"
+#include <algorithm>
+#include <cmath>
+
+Plant::Plant (const PlantConfig &config) : cfg(config), rng(config.seed) {
+}
+
+void Plant::setSetpoint (double value) {
+    // The DAC only has so many steps.
+    double steps = (1 << cfg.dacBits) - 1;
+    setpoint = std::round(std::min(std::max(value, 0.0), 1.0) * steps) / steps;
+}
+
+void Plant::setWall (bool present, double where) {
+// The wall (a hand, usually) blocks the rod on its way toward 1.0, which is the direction calibrate() sweeps in.
+    wallPresent = present;
+    wallPosition = where;
+}
+
+void Plant::setHand (double first, double second) {
+/*
+A hand that acts like a person calibrating: it holds at the first position until it's been pushed on for a moment,
+then moves to the second, and gets out of the way once it's been pushed on there too. Unlike a scripted wall it
+doesn't care when calibration gets round to it, which is what axes other than the first need.
+*/
+    setWall(true, first);
+    handStage = 1;
+    handSecond = second;
+    pressedFor = 0;
+}
+
+double Plant::cellForce () const {
+// The load cell sits between the rod and the world, so it sees the hand/wall and nothing else.
+    double force = externalForce;
+    if (wallPresent) {
+        double penetration = x - wallPosition;
+        if (penetration > 0) {
+            force -= cfg.wallStiffness * penetration;
+        }
+    }
+    return force;
+}
+
+void Plant::advance (double seconds) {
+    double end = t + seconds;
+    while (t < end) {
+        double dt = std::min(cfg.stepSeconds, end - t);
+        double servo = cfg.servoStiffness * (setpoint - x) - cfg.servoDamping * v;
+        servo = std::min(std::max(servo, -cfg.servoMaxForce), cfg.servoMaxForce);
+        double friction = cfg.viscousFriction * v;
+        if (v != 0) {
+            friction += std::copysign(cfg.coulombFriction, v);
+        }
+        double accel = (servo + cellForce() - friction) / cfg.mass;
+        // Semi-implicit Euler: plenty stable at these step sizes.
+        v += accel * dt;
+        x += v * dt;
+        if (x < cfg.stopLow) {
+            x = cfg.stopLow;
+            v = 0;
+        }
+        else if (x > cfg.stopHigh) {
+            x = cfg.stopHigh;
+            v = 0;
+        }
+        t += dt;
+        if (handStage == 1 || handStage == 2) {
+            const double feelSeconds {0.3};
+            pressedFor = cellForce() < -0.1 ? pressedFor + dt : 0;
+            if (pressedFor >= feelSeconds) {
+                pressedFor = 0;
+                ++handStage;
+                setWall(handStage == 2, handSecond);
+            }
+        }
+    }
+}
+
+double Plant::sampleVoltage () {
+    double volts = cfg.zeroVolts + cellForce() * cfg.voltsPerForce + gauss(rng) * cfg.noise;
+    double steps = (1 << cfg.adcBits) - 1;
+    return std::round(std::min(std::max(volts, 0.0), 1.0) * steps) / steps;
+}
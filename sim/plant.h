@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+/*
+A model of what's on the other end of p18 and p20: the linear actuator (with its own position servo),
+whatever mass is hanging off it, and the load cell + amplifier that feeds fromAmp.
+Positions are in the same 0-1 units as toActuator, forces are in the same units as inScaled
+(so a force of 1.0 reads as a full inRange swing away from the zero voltage).
+*/
+
+struct PlantConfig {
+    double mass {1.0};            // Moving mass of the rod and load.
+    double viscousFriction {2.0}; // Friction proportional to speed.
+    double coulombFriction {0.05};// Friction that only cares about direction.
+    double servoStiffness {36000};// The actuator's internal position loop. These two give roughly a 30Hz, critically damped servo.
+    double servoDamping {380};
+    double servoMaxForce {400};
+    double stopLow {0.0};         // Hard end stops of the rod.
+    double stopHigh {1.0};
+    double wallStiffness {20};    // How hard the "hand" is when the rod runs into it.
+    double zeroVolts {0.5};       // Amplifier output with no load, 0-1.
+    double voltsPerForce {0.3};   // Should match inRange.
+    double noise {0.002};         // Standard deviation of the amplifier noise, in the 0-1 AnalogIn units.
+    int adcBits {12};
+    int dacBits {10};
+    double stepSeconds {0.0001};  // Physics substep.
+    unsigned seed {1};
+};
+
+class Plant {
+public:
+    explicit Plant (const PlantConfig &config = PlantConfig());
+    void setSetpoint (double setpoint);  // What the DAC is currently outputting.
+    void setWall (bool present, double position);
+    void setHand (double first, double second);   // A wall that moves on by itself; see plant.cpp.
+    void setExternalForce (double force) { externalForce = force; }
+    void advance (double seconds);
+    double sampleVoltage ();             // One (noisy, quantized) ADC conversion.
+    double position () const { return x; }
+    double speed () const { return v; }
+    double cellForce () const;
+    double time () const { return t; }
+private:
+    PlantConfig cfg;
+    std::mt19937 rng;
+    std::normal_distribution<double> gauss {0.0, 1.0};
+    double setpoint {0};
+    double x {0};
+    double v {0};
+    double t {0};
+    double externalForce {0};
+    bool wallPresent {false};
+    double wallPosition {1.0};
+    int handStage {0}; // 0: no hand. 1: at the first limit. 2: at the second. 3: gone.
+    double handSecond {1.0};
+    double pressedFor {0};
+};
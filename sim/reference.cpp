@@ -0,0 +1,92 @@
+#include "reference.h"
+#include "controller.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+// Both of these work on the first axis, same as checkFutureAUC().
+float referenceSpecialSauce (float input) {
+    float factor = 5.5 + std::copysign(4.5, input * axes.velocity[0] + 0.00000001);
+    return input / factor;
+}
+
+float referenceFutureAUC () {
+    float slope = axes.inScaled[0] - axes.inScaledPrior[0];
+    float point = axes.inScaled[0];
+    float auc = referenceSpecialSauce(axes.inScaledPrior[0]) * 3;
+    for (int i = tuning.predictXCyclesAhead[0] + 1; i > 0; --i) {
+        auc += referenceSpecialSauce(point);
+        point += slope;
+    }
+    return auc;
+}
+
+bool checkFutureAUC () {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(-1, 1);
+    const int horizons[] = {0, 1, 2, 5, 20, 21, 100, 500};
+    float savedInScaled = axes.inScaled[0];
+    float savedPrior = axes.inScaledPrior[0];
+    float savedVelocity = axes.velocity[0];
+    int savedHorizon = tuning.predictXCyclesAhead[0];
+    ForceEstimator savedEstimator = tuning.estimator[0];
+    // The reference is the original per-point loop, slope and all.
+    tuning.estimator[0] = ForceEstimator::TwoSample;
+    double worst {0};
+    long cases {0};
+    bool ok {true};
+    for (int horizon : horizons) {
+        tuning.predictXCyclesAhead[0] = horizon;
+        for (int i = 0; i < 200000; ++i) {
+            axes.inScaled[0] = unit(rng);
+            // Small slopes are what the loop actually sees; big ones shake out the crossing arithmetic.
+            axes.inScaledPrior[0] = axes.inScaled[0] - unit(rng) * (i % 2 ? 0.01f : 1.0f);
+            switch (i % 4) {
+                case 0: axes.velocity[0] = 0; break;
+                case 1: axes.velocity[0] = unit(rng) * tuning.maxSpeed[0]; break;
+                case 2: axes.velocity[0] = unit(rng) * 1e-6f; break;
+                default: axes.velocity[0] = unit(rng); break;
+            }
+            if (i % 16 == 3) {
+                axes.inScaled[0] = 0; // Exactly on the crossing.
+            }
+            float expected = referenceFutureAUC();
+            float got = calculateFutureAUC(0);
+            // The loop accumulates rounding error as it goes, so the allowance grows with the horizon and with how
+            // big the points get.
+            float inScaled {axes.inScaled[0]};
+            float inScaledPrior {axes.inScaledPrior[0]};
+            float slope = inScaled - inScaledPrior;
+            float velocity = axes.velocity[0];
+            float scale = std::fabs(inScaled) + std::fabs(inScaledPrior) + horizon * std::fabs(slope);
+            double error = std::fabs((double)got - expected);
+            double allowed = 1e-5 * (horizon + 4) * (horizon + 4) * (scale + 1);
+            // A point within rounding of specialSauce()'s sign test can land on either side of it in either version,
+            // which is worth 0.9 of that point. Only those get let off, and only by that much.
+            for (int point = 0; point <= horizon; ++point) {
+                double at = (double)inScaled + (double)point * slope;
+                double test = at * velocity + 1e-8;
+                double size = (std::fabs(inScaled) + point * std::fabs(slope)) * std::fabs(velocity) + 1e-8;
+                double rounding = 1e-6 * (point + 2) * size;
+                if (std::fabs(test) <= rounding) {
+                    allowed += 0.9 * std::fabs(at);
+                }
+            }
+            worst = std::max(worst, error / allowed);
+            if (error > allowed && ok) {
+                printf("calculateFutureAUC() mismatch: horizon %d, inScaled %g, inScaledPrior %g, velocity %g: %g vs %g\n",
+                       horizon, inScaled, inScaledPrior, axes.velocity[0], got, expected);
+                ok = false;
+            }
+            ++cases;
+        }
+    }
+    printf("calculateFutureAUC() vs per-point loop: %ld cases, worst error %.3f of allowance\n", cases, worst);
+    axes.inScaled[0] = savedInScaled;
+    axes.inScaledPrior[0] = savedPrior;
+    axes.velocity[0] = savedVelocity;
+    tuning.predictXCyclesAhead[0] = savedHorizon;
+    tuning.estimator[0] = savedEstimator;
+    return ok;
+}
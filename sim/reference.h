@@ -0,0 +1,14 @@
+#pragma once
+
+/*
+The controller's algorithms the way they were first written, one point at a time.
+They're slow, but they're the definition; the faster versions in controller.cpp get checked against these.
+They read the same globals as controller.cpp (velocity, inScaled, ...).
+*/
+
+float referenceSpecialSauce (float input);
+float referenceFutureAUC ();
+
+// Compares calculateFutureAUC() against referenceFutureAUC() over random and edge-case inputs.
+// Prints a summary and returns false if they ever disagree by more than float rounding should allow.
+bool checkFutureAUC ();
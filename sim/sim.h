@@ -0,0 +1,50 @@
+#pragma once
+
+#include "plant.h"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/*
+Shared state between the simulated board (board_sim.cpp) and whatever is driving it (sim_main.cpp).
+Every axis gets its own plant. Scenario events all happen to the first one.
+Time here is virtual: sleepMs() advances the plant instead of waiting, so runs go as fast as the host allows.
+*/
+
+struct SimEvent {
+    enum Kind { Wall, Push, Master };
+    double time;
+    Kind kind;
+    double value; // Wall: position, or negative for no wall. Push: external force. Master: 0 or 1.
+};
+
+struct SimLoopStats {
+    uint64_t ticks {0};
+    double controllerSeconds {0}; // Host time spent between sleeps, i.e. in controller code.
+    double worstTickSeconds {0};
+};
+
+void simSetup (const PlantConfig &config, const std::vector<SimEvent> &events);
+Plant &simPlant (int axis);
+void simSetTelemetryOutput (FILE *file); // Where writeTelemetry() goes; nullptr throws it away.
+void simSetFlashFile (const char *path); // Keeps the simulated flash in a file, so it survives between runs.
+double simSeconds ();
+const SimLoopStats &simLoopStats ();
+
+// Puts the controller's globals back how they are at power-up, for running more than one scenario per process.
+void resetControllerState ();
+
+// engines.cpp: float vs fixed-point engine on the same scenario. False if a single tick disagrees noticeably.
+bool compareFixedEngine (const PlantConfig &config, const std::vector<SimEvent> &events, double seconds);
+
+// estimators.cpp: phase lag and noise of each force-rate estimator, and what they do to the actuator.
+void compareEstimators (const PlantConfig &config);
+
+// compliance.cpp: the predictor against the model-predictive mode (mpc.h), for latency, tracking and limits.
+void compareComplianceModes (const PlantConfig &config);
+
+// sweep.cpp: "roborock-sim sweep ...", parameter sweeps over replayed force traces.
+int sweepMain (int argc, char **argv);
+
+// bench.cpp: "roborock-sim bench ...", control-path microbenchmarks and latencies, checked against a baseline.
+int benchMain (int argc, char **argv);
@@ -0,0 +1,341 @@
+/*
+Host build of the controller, running against the simulated plant in plant.cpp instead of the LPC1768.
+Build it from the repository root with something like:
+
+    g++ -std=gnu++14 -O2 -I. controller.cpp controller_fixed.cpp looptimer.cpp profiler.cpp telemetry.cpp trajectory.cpp \
+        calibration.cpp motion.cpp masterinput.cpp estimator.cpp idlemode.cpp fixtures.cpp flightrecorder.cpp \
+        safety.cpp mpc.cpp sim/plant.cpp sim/board_sim.cpp sim/reference.cpp sim/engines.cpp sim/estimators.cpp \
+        sim/compliance.cpp sim/sweep.cpp sim/bench.cpp sim/sim_main.cpp -o roborock-sim
+
+Add -DMBED_CONF_APP_<OPTION>=... to try the options from mbed_app.json (see config.h).
+
+It runs the same startup calibration and main loop as main.cpp, on virtual time, so a few thousand simulated
+seconds take a few seconds. The default scenario mimics what a person does at power-up: a hand blocks the
+first sweep, moves further down for the second, then gets out of the way and pushes the rod around a bit.
+"roborock-sim sweep" is a different tool: parameter sweeps over recorded force traces (see sweep.cpp). So is
+"roborock-sim bench": benchmarks of the control path, checked against a baseline (see bench.cpp).
+*/
+
+#include "board.h"
+#include "calibration.h"
+#include "config.h"
+#include "controller.h"
+#include "fixtures.h"
+#include "flightrecorder.h"
+#include "idlemode.h"
+#include "looptimer.h"
+#include "masterinput.h"
+#include "motion.h"
+#include "profiler.h"
+#include "safety.h"
+#include "telemetry.h"
+#include "reference.h"
+#include "sim.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+void usage () {
+    printf(
+        "usage: roborock-sim [options]\n"
+        "       roborock-sim sweep [options]   (parameter sweeps; sweep --help for more)\n"
+        "       roborock-sim bench [options]   (benchmarks; bench --help for more)\n"
+        "  --seconds S        simulated run length (default 30)\n"
+        "  --mass M           moving mass\n"
+        "  --friction B       viscous friction\n"
+        "  --coulomb F        coulomb friction\n"
+        "  --stops LO,HI      end stop positions\n"
+        "  --noise N          amplifier noise, standard deviation in 0-1 ADC units\n"
+        "  --seed N           noise seed\n"
+        "  --wall T,POS       at time T, put the hand at POS (negative removes it)\n"
+        "  --push T,F         at time T, start pushing with force F\n"
+        "  --master T,0|1     at time T, set fromMaster (T to the microsecond, so pulses can fall between ticks)\n"
+        "  --move T,POS[,C]   at time T, queue a move to POS with compliance C (default 0)\n"
+        "  --stall T,MS       at time T, hold the loop up for MS milliseconds, as if the control thread had hung\n"
+        "  --fixture K,FROM,TO,STRENGTH[,AT]\n"
+        "                     a virtual fixture on axis 0 once it's calibrated (fixtures.h); K is spring, wall, detent\n"
+        "                     or viscous. Give it again for more, up to 8\n"
+        "  --trace FILE       write one CSV line per tick\n"
+        "  --flash FILE       keep the stored calibration in FILE, so the next run with it starts warm\n"
+        "  --telemetry FILE   record the binary telemetry stream (decode with tools/decode_telemetry.py)\n"
+        "  --dump-recorder    print the flight recorder's capture at the end, if anything triggered it\n"
+        "  --check-auc        compare calculateFutureAUC() against the original per-point loop and exit\n"
+        "  --compare-fixed    run the scenario on the float and fixed-point engines side by side and exit\n"
+        "  --compare-estimators  measure each force-rate estimator's lag and noise, and exit (give plant options first)\n"
+        "  --compare-mpc      the predictor against the model-predictive mode (mpc.h), and exit (plant options first)\n"
+        "Giving any --wall/--push/--master replaces the default scenario.\n");
+}
+
+bool parsePair (const char *text, double &a, double &b) {
+    return sscanf(text, "%lf,%lf", &a, &b) == 2;
+}
+
+bool parseFixture (const char *text, Fixture &fixture) {
+    const char *kinds[] {"spring", "wall", "detent", "viscous"};
+    char kind[16];
+    fixture.at = 0;
+    if (sscanf(text, "%15[^,],%f,%f,%f,%f", kind, &fixture.from, &fixture.to, &fixture.strength, &fixture.at) < 4) {
+        return false;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (strcmp(kind, kinds[i]) == 0) {
+            fixture.kind = (FixtureKind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct TimedMove {
+    double time;
+    float to;
+    float compliance;
+};
+
+struct TimedStall {
+    double time;
+    uint32_t ms;
+};
+
+}
+
+int main (int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "sweep") == 0) {
+        return sweepMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return benchMain(argc - 1, argv + 1);
+    }
+    PlantConfig config;
+    double seconds {30};
+    const char *tracePath {nullptr};
+    const char *telemetryPath {nullptr};
+    const char *flashPath {nullptr};
+    bool compareFixed {false};
+    bool dumpRecorder {false};
+    std::vector<SimEvent> events;
+    std::vector<TimedMove> moves;
+    std::vector<TimedStall> stalls;
+    std::vector<Fixture> fixtures;
+    Fixture fixture;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--check-auc") == 0) {
+            return checkFutureAUC() ? 0 : 1;
+        }
+        if (strcmp(arg, "--compare-fixed") == 0) {
+            compareFixed = true;
+            continue;
+        }
+        if (strcmp(arg, "--dump-recorder") == 0) {
+            dumpRecorder = true;
+            continue;
+        }
+        if (strcmp(arg, "--compare-estimators") == 0) {
+            compareEstimators(config);
+            return 0;
+        }
+        if (strcmp(arg, "--compare-mpc") == 0) {
+            compareComplianceModes(config);
+            return 0;
+        }
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        double a, b;
+        if (value == nullptr) {
+            usage();
+            return 1;
+        }
+        ++i;
+        if (strcmp(arg, "--seconds") == 0) {
+            seconds = atof(value);
+        }
+        else if (strcmp(arg, "--mass") == 0) {
+            config.mass = atof(value);
+        }
+        else if (strcmp(arg, "--friction") == 0) {
+            config.viscousFriction = atof(value);
+        }
+        else if (strcmp(arg, "--coulomb") == 0) {
+            config.coulombFriction = atof(value);
+        }
+        else if (strcmp(arg, "--stops") == 0 && parsePair(value, a, b)) {
+            config.stopLow = a;
+            config.stopHigh = b;
+        }
+        else if (strcmp(arg, "--noise") == 0) {
+            config.noise = atof(value);
+        }
+        else if (strcmp(arg, "--seed") == 0) {
+            config.seed = (unsigned)atoi(value);
+        }
+        else if (strcmp(arg, "--wall") == 0 && parsePair(value, a, b)) {
+            events.push_back({a, SimEvent::Wall, b});
+        }
+        else if (strcmp(arg, "--push") == 0 && parsePair(value, a, b)) {
+            events.push_back({a, SimEvent::Push, b});
+        }
+        else if (strcmp(arg, "--master") == 0 && parsePair(value, a, b)) {
+            events.push_back({a, SimEvent::Master, b});
+        }
+        else if (strcmp(arg, "--move") == 0 && parsePair(value, a, b)) {
+            float compliance {0};
+            sscanf(value, "%*f,%*f,%f", &compliance);
+            moves.push_back({a, (float)b, compliance});
+        }
+        else if (strcmp(arg, "--stall") == 0 && parsePair(value, a, b)) {
+            stalls.push_back({a, (uint32_t)b});
+        }
+        else if (strcmp(arg, "--fixture") == 0 && parseFixture(value, fixture)) {
+            fixtures.push_back(fixture);
+        }
+        else if (strcmp(arg, "--trace") == 0) {
+            tracePath = value;
+        }
+        else if (strcmp(arg, "--telemetry") == 0) {
+            telemetryPath = value;
+        }
+        else if (strcmp(arg, "--flash") == 0) {
+            flashPath = value;
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (events.empty()) {
+        events = {
+            {0.0, SimEvent::Wall, 0.3},
+            {3.0, SimEvent::Wall, 0.85},
+            {7.5, SimEvent::Wall, -1},
+            {9.0, SimEvent::Push, 0.2},
+            {9.5, SimEvent::Push, 0.0},
+            {11.0, SimEvent::Push, -0.2},
+            {11.5, SimEvent::Push, 0.0},
+            {14.0, SimEvent::Master, 1},
+            {14.3, SimEvent::Master, 0},
+        };
+    }
+    if (compareFixed) {
+        return compareFixedEngine(config, events, seconds) ? 0 : 1;
+    }
+    FILE *trace = nullptr;
+    if (tracePath != nullptr) {
+        trace = fopen(tracePath, "w");
+        if (trace == nullptr) {
+            perror(tracePath);
+            return 1;
+        }
+        fprintf(trace, "time,inScaled,velocity,anticipatedAUC,command,position,force\n");
+    }
+
+    FILE *telemetry = nullptr;
+    if (telemetryPath != nullptr) {
+        telemetry = fopen(telemetryPath, "wb");
+        if (telemetry == nullptr) {
+            perror(telemetryPath);
+            return 1;
+        }
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    simSetup(config, events);
+    simSetTelemetryOutput(telemetry);
+    if (flashPath != nullptr) {
+        simSetFlashFile(flashPath);
+    }
+    boardInit();
+    startControlLoop(MBED_CONF_APP_CONTROL_PERIOD_US);
+    calibrateAtStartup();
+    resetLoopTiming();
+    resetProfile();
+    resetMasterInput();
+    resetIdleMode();
+    loadFixtures(0, fixtures.data(), (int)fixtures.size());
+    if (telemetry != nullptr) {
+        startTelemetry();
+    }
+    startSafety();
+    // The trace, and the scenario, are about the first axis. Any others just calibrate against their hand and comply.
+    float lowest {axes.command[0]};
+    float highest {axes.command[0]};
+    std::stable_sort(moves.begin(), moves.end(), [](const TimedMove &a, const TimedMove &b) { return a.time < b.time; });
+    std::stable_sort(stalls.begin(), stalls.end(), [](const TimedStall &a, const TimedStall &b) { return a.time < b.time; });
+    size_t nextMove {0};
+    size_t nextStall {0};
+    while (simSeconds() < seconds) {
+        // Queued from the loop, between ticks, the way a console command would be on target.
+        while (nextMove < moves.size() && moves[nextMove].time <= simSeconds()) {
+            // Compliant moves are meant to be pushed on, so only the rigid ones yield.
+            queueMove(0, moves[nextMove].to, fullSpeed(0), moves[nextMove].compliance == 0, moves[nextMove].compliance);
+            ++nextMove;
+        }
+        controlStep();
+        if (telemetry != nullptr) {
+            recordTelemetry(readMaster());
+        }
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+        for (int axis = 0; axis < axisCount; ++axis) {
+            publishFixedState(axis);
+        }
+#endif
+        if (axes.command[0] < lowest) {
+            lowest = axes.command[0];
+        }
+        if (axes.command[0] > highest) {
+            highest = axes.command[0];
+        }
+        if (trace != nullptr) {
+            Plant &plant = simPlant(0);
+            fprintf(trace, "%.4f,%f,%f,%f,%f,%f,%f\n", simSeconds(), axes.inScaled[0], axes.velocity[0],
+                    axes.anticipatedAUC[0], axes.command[0], plant.position(), plant.cellForce());
+        }
+        // The plant carries on while the loop's held up; the ticker interrupt's stall check is what catches it.
+        while (nextStall < stalls.size() && stalls[nextStall].time <= simSeconds()) {
+            sleepMs(stalls[nextStall++].ms);
+        }
+        waitForControlTick();
+    }
+    double hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (trace != nullptr) {
+        fclose(trace);
+    }
+    if (telemetry != nullptr) {
+        drainTelemetry();
+        fclose(telemetry);
+        printTelemetryStats();
+    }
+
+    const SimLoopStats &stats = simLoopStats();
+    printf("simulated %.1f s in %.2f s of host time (%.0fx real time)\n", simSeconds(), hostSeconds,
+           simSeconds() / hostSeconds);
+    if (stats.ticks > 0) {
+        printf("controller time per tick: mean %.3f us, worst %.3f us over %llu ticks\n",
+               stats.controllerSeconds / stats.ticks * 1e6, stats.worstTickSeconds * 1e6,
+               (unsigned long long)stats.ticks);
+    }
+    printLoopTiming();
+    printMasterInputStats();
+    printIdleStats();
+    printSafetyStats();
+    if (dumpRecorder && flightRecorderFrozen()) {
+        dumpFlightRecorder();
+    }
+    else {
+        printFlightRecorderStatus();
+    }
+    if (MBED_CONF_APP_PROFILING) {
+        printf("(simulator 'cycles' are host nanoseconds)\n");
+        printProfile();
+    }
+    printf("limits: outMin %f, outMax %f; command ranged %f ... %f after calibration\n", axes.outMin[0], axes.outMax[0],
+           lowest, highest);
+    for (int axis = 1; axis < axisCount; ++axis) {
+        printf("axis %d limits: outMin %f, outMax %f\n", axis, axes.outMin[axis], axes.outMax[axis]);
+    }
+    return 0;
+}
@@ -0,0 +1,378 @@
+/*
+Replays force traces through comply() for a grid of tuning values, and scores each set on how the response
+looks: how long after a push ends the actuator takes to settle, how far it coasts past where the push left it
+(overshoot), and how long it takes to get moving once a push starts (force-to-motion lag).
+
+    roborock-sim sweep --trace capture.csv --slickness 0.99:0.9999:10 --inertia 0.25:2:8 --jobs 8
+
+Traces are inScaled per tick: a CSV with an inScaled column (tools/decode_telemetry.py output, or the
+simulator's own --trace), or one of the synthetic ones. The replay feeds them straight into inScaled, so
+readInputs() and the plant are out of the loop and it's pure comply() math: millions of ticks a second per core.
+controller.cpp keeps its state in globals, so the grid is split across forked worker processes, not threads.
+*/
+
+#include "sim.h"
+#include "controller.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct SweepParams {
+    float slickness;
+    float inertia;
+    int horizon;
+    float maxSpeed;
+    float maxAcceleration;
+};
+
+struct SweepScore {
+    SweepParams params;
+    double settleMs;
+    double overshoot;
+    double lagMs;
+    double score;
+};
+
+struct Push {
+    size_t onset;
+    size_t release;
+    size_t end; // The next onset, or the end of the trace.
+};
+
+struct Range {
+    double first;
+    double last;
+    int count;
+    double at (int i) const { return count > 1 ? first + (last - first) * i / (count - 1) : first; }
+};
+
+const float pushThreshold {0.05f};
+const float settledSpeed {0.0001f}; // Absolute, so faster tunings don't get an easier target.
+
+bool parseRange (const char *text, Range &range) {
+    range.count = 1;
+    int fields = sscanf(text, "%lf:%lf:%d", &range.first, &range.last, &range.count);
+    if (fields == 1) {
+        range.last = range.first;
+        range.count = 1;
+    }
+    return fields == 1 || (fields == 3 && range.count > 0);
+}
+
+std::vector<float> loadTrace (const char *path) {
+    std::vector<float> trace;
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        perror(path);
+        return trace;
+    }
+    char line[512];
+    int column {0};
+    if (fgets(line, sizeof(line), file) != nullptr) {
+        // Find the inScaled column; a file without a header is taken to be one number per line.
+        char *field = strtok(line, ",\r\n");
+        for (int i = 0; field != nullptr; ++i, field = strtok(nullptr, ",\r\n")) {
+            if (strcmp(field, "inScaled") == 0) {
+                column = i;
+            }
+        }
+        if (atof(line) != 0 || line[0] == '0') {
+            trace.push_back((float)atof(line));
+        }
+    }
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char *field = strtok(line, ",\r\n");
+        for (int i = 0; field != nullptr && i < column; ++i) {
+            field = strtok(nullptr, ",\r\n");
+        }
+        if (field != nullptr) {
+            trace.push_back((float)atof(field));
+        }
+    }
+    fclose(file);
+    return trace;
+}
+
+std::vector<float> syntheticTrace (const char *name, double seconds) {
+/*
+"pushes": alternating half-second pushes of growing strength with rests between; "sine": a slow back-and-forth;
+both with amplifier-like noise on top.
+*/
+    std::vector<float> trace((size_t)(seconds * 1000));
+    std::mt19937 rng(3);
+    std::normal_distribution<float> noise(0, 0.007f);
+    bool sine = strcmp(name, "sine") == 0;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        double t = i / 1000.0;
+        float force;
+        if (sine) {
+            force = 0.2f * (float)std::sin(2 * M_PI * 0.5 * t);
+        }
+        else {
+            int cycle = (int)(t / 2.5);
+            double phase = t - cycle * 2.5;
+            force = phase < 0.5 ? (cycle % 2 ? -1 : 1) * 0.1f * (1 + cycle % 4) : 0;
+        }
+        trace[i] = force + noise(rng);
+    }
+    return trace;
+}
+
+std::vector<Push> findPushes (const std::vector<float> &trace) {
+// A push starts when the force clears pushThreshold and ends when it's been back under for 50 ticks.
+    std::vector<Push> pushes;
+    size_t quiet {0};
+    bool pushing {false};
+    for (size_t i = 0; i < trace.size(); ++i) {
+        bool strong = std::fabs(trace[i]) > pushThreshold;
+        if (!pushing && strong) {
+            if (!pushes.empty()) {
+                pushes.back().end = i;
+            }
+            pushes.push_back({i, trace.size(), trace.size()});
+            pushing = true;
+            quiet = 0;
+        }
+        else if (pushing) {
+            quiet = strong ? 0 : quiet + 1;
+            if (quiet == 50) {
+                pushes.back().release = i - 49;
+                pushing = false;
+            }
+        }
+    }
+    return pushes;
+}
+
+SweepScore replay (const std::vector<float> &trace, const std::vector<Push> &pushes, const SweepParams &params,
+                   std::vector<float> &speeds, std::vector<float> &positions) {
+    resetControllerState();
+    // Replays go through the first axis; the tuning is per axis, but the math isn't. The tuning globals only count
+    // with liveTuning on.
+    liveTuning = true;
+    tuning.slickness[0] = params.slickness;
+    tuning.inertia[0] = params.inertia;
+    tuning.predictXCyclesAhead[0] = params.horizon;
+    tuning.maxSpeed[0] = params.maxSpeed;
+    tuning.maxAcceleration[0] = params.maxAcceleration;
+    axes.command[0] = 0.5f; // Mid-range, so the limits stay out of it.
+    resetForceEstimator(0);
+    for (size_t i = 0; i < trace.size(); ++i) {
+        axes.inScaledPrior[0] = axes.inScaled[0];
+        axes.inScaled[0] = trace[i];
+        estimateForceRate(0);
+        comply(0);
+        speeds[i] = axes.velocity[0];
+        positions[i] = axes.command[0];
+    }
+
+    SweepScore score {params, 0, 0, 0, 0};
+    for (const Push &push : pushes) {
+        float peak {0};
+        for (size_t i = push.onset; i < push.release; ++i) {
+            peak = std::max(peak, std::fabs(speeds[i]));
+        }
+        size_t moving = push.onset;
+        while (moving < push.release && std::fabs(speeds[moving]) < peak / 2) {
+            ++moving;
+        }
+        size_t settled = push.release;
+        for (size_t i = push.release; i < push.end; ++i) {
+            if (std::fabs(speeds[i]) >= settledSpeed) {
+                settled = i + 1;
+            }
+        }
+        float pushed = std::fabs(positions[push.release] - positions[push.onset]);
+        float coasted = std::fabs(positions[settled < push.end ? settled : push.end - 1] - positions[push.release]);
+        score.lagMs += moving - push.onset;
+        score.settleMs += settled - push.release;
+        score.overshoot += coasted / std::max(pushed, 0.001f);
+    }
+    if (!pushes.empty()) {
+        score.lagMs /= pushes.size();
+        score.settleMs /= pushes.size();
+        score.overshoot /= pushes.size();
+    }
+    score.score = score.settleMs + 4 * score.lagMs + 500 * score.overshoot;
+    return score;
+}
+
+void usage () {
+    printf(
+        "usage: roborock-sim sweep [options]\n"
+        "  --trace FILE               inScaled per tick, CSV (an inScaled column) or one value per line\n"
+        "  --synthetic pushes|sine    generated trace instead (default pushes)\n"
+        "  --seconds S                length of a synthetic trace (default 60)\n"
+        "  --slickness A[:B:N]        a value, or N values from A to B; same for the rest\n"
+        "  --inertia A[:B:N]\n"
+        "  --horizon A[:B:N]          predictXCyclesAhead\n"
+        "  --max-speed A[:B:N]\n"
+        "  --max-acceleration A[:B:N]\n"
+        "  --jobs N                   worker processes (default: one per core)\n"
+        "  --top N                    how many of the best to print (default 10)\n"
+        "  --out FILE                 every result, as CSV\n"
+        "Score is settle_ms + 4 * lag_ms + 500 * overshoot; lower is better.\n");
+}
+
+}
+
+int sweepMain (int argc, char **argv) {
+    Range slicknesses {tuning.slickness[0], tuning.slickness[0], 1};
+    Range inertias {tuning.inertia[0], tuning.inertia[0], 1};
+    Range horizons {(double)tuning.predictXCyclesAhead[0], (double)tuning.predictXCyclesAhead[0], 1};
+    Range speeds {tuning.maxSpeed[0], tuning.maxSpeed[0], 1};
+    Range accelerations {tuning.maxAcceleration[0], tuning.maxAcceleration[0], 1};
+    const char *tracePath {nullptr};
+    const char *synthetic {"pushes"};
+    const char *outPath {nullptr};
+    double seconds {60};
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    int top {10};
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        bool ok {value != nullptr};
+        if (!ok) {
+            // Every option takes a value.
+        }
+        else if (strcmp(arg, "--trace") == 0) {
+            tracePath = value;
+        }
+        else if (strcmp(arg, "--synthetic") == 0) {
+            synthetic = value;
+        }
+        else if (strcmp(arg, "--seconds") == 0) {
+            seconds = atof(value);
+        }
+        else if (strcmp(arg, "--slickness") == 0) {
+            ok = parseRange(value, slicknesses);
+        }
+        else if (strcmp(arg, "--inertia") == 0) {
+            ok = parseRange(value, inertias);
+        }
+        else if (strcmp(arg, "--horizon") == 0) {
+            ok = parseRange(value, horizons);
+        }
+        else if (strcmp(arg, "--max-speed") == 0) {
+            ok = parseRange(value, speeds);
+        }
+        else if (strcmp(arg, "--max-acceleration") == 0) {
+            ok = parseRange(value, accelerations);
+        }
+        else if (strcmp(arg, "--jobs") == 0) {
+            jobs = std::max(1, atoi(value));
+        }
+        else if (strcmp(arg, "--top") == 0) {
+            top = atoi(value);
+        }
+        else if (strcmp(arg, "--out") == 0) {
+            outPath = value;
+        }
+        else {
+            ok = false;
+        }
+        if (!ok) {
+            usage();
+            return 1;
+        }
+    }
+
+    std::vector<float> trace = tracePath != nullptr ? loadTrace(tracePath) : syntheticTrace(synthetic, seconds);
+    if (trace.empty()) {
+        fprintf(stderr, "empty trace\n");
+        return 1;
+    }
+    std::vector<Push> pushes = findPushes(trace);
+    std::vector<SweepParams> grid;
+    for (int a = 0; a < slicknesses.count; ++a) {
+        for (int b = 0; b < inertias.count; ++b) {
+            for (int c = 0; c < horizons.count; ++c) {
+                for (int d = 0; d < speeds.count; ++d) {
+                    for (int e = 0; e < accelerations.count; ++e) {
+                        grid.push_back({(float)slicknesses.at(a), (float)inertias.at(b), std::max(1, (int)std::lround(horizons.at(c))),
+                                        (float)speeds.at(d), (float)accelerations.at(e)});
+                    }
+                }
+            }
+        }
+    }
+    jobs = std::min<int>(jobs, grid.size());
+
+    // Each worker takes every jobs-th set and writes its scores back down a pipe.
+    auto started = std::chrono::steady_clock::now();
+    std::vector<int> pipes;
+    std::vector<pid_t> workers;
+    for (int worker = 0; worker < jobs; ++worker) {
+        int ends[2];
+        if (pipe(ends) != 0) {
+            perror("pipe");
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(ends[0]);
+            std::vector<float> workSpeeds(trace.size());
+            std::vector<float> workPositions(trace.size());
+            for (size_t i = worker; i < grid.size(); i += jobs) {
+                SweepScore score = replay(trace, pushes, grid[i], workSpeeds, workPositions);
+                if (write(ends[1], &score, sizeof(score)) != (ssize_t)sizeof(score)) {
+                    _exit(1);
+                }
+            }
+            _exit(0);
+        }
+        close(ends[1]);
+        pipes.push_back(ends[0]);
+        workers.push_back(pid);
+    }
+    std::vector<SweepScore> scores;
+    for (int fd : pipes) {
+        SweepScore score;
+        while (read(fd, &score, sizeof(score)) == (ssize_t)sizeof(score)) {
+            scores.push_back(score);
+        }
+        close(fd);
+    }
+    for (pid_t pid : workers) {
+        waitpid(pid, nullptr, 0);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::sort(scores.begin(), scores.end(), [](const SweepScore &a, const SweepScore &b) { return a.score < b.score; });
+    const char *header = "slickness,inertia,horizon,maxSpeed,maxAcceleration,settle_ms,overshoot,lag_ms,score\n";
+    auto print = [](FILE *to, const SweepScore &s) {
+        fprintf(to, "%g,%g,%d,%g,%g,%.1f,%.3f,%.1f,%.1f\n", s.params.slickness, s.params.inertia, s.params.horizon,
+                s.params.maxSpeed, s.params.maxAcceleration, s.settleMs, s.overshoot, s.lagMs, s.score);
+    };
+    if (outPath != nullptr) {
+        FILE *out = fopen(outPath, "w");
+        if (out == nullptr) {
+            perror(outPath);
+            return 1;
+        }
+        fputs(header, out);
+        for (const SweepScore &score : scores) {
+            print(out, score);
+        }
+        fclose(out);
+    }
+    fputs(header, stdout);
+    for (int i = 0; i < top && i < (int)scores.size(); ++i) {
+        print(stdout, scores[i]);
+    }
+    double steps = (double)scores.size() * trace.size();
+    fprintf(stderr, "%zu parameter sets x %zu ticks (%zu pushes) on %d workers: %.2f s, %.1fM ticks/s\n", scores.size(),
+            trace.size(), pushes.size(), jobs, elapsed, steps / elapsed / 1e6);
+    return scores.size() == grid.size() ? 0 : 1;
+}
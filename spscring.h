@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*
+A single-producer, single-consumer ring buffer with no locks: one side only ever moves head, the other only tail,
+and each publishes with a release store that the other picks up with an acquire load. Safe between an ISR or
+the control thread on one side and a lower-priority thread on the other, and it never blocks either of them.
+Size has to be a power of two; the ring holds Size - 1 items.
+*/
+
+template <typename T, uint32_t Size>
+class SpscRing {
+    static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "SpscRing size must be a power of two");
+public:
+    bool push (const T &item) {
+        uint32_t head = headIndex.load(std::memory_order_relaxed);
+        uint32_t next = (head + 1) & (Size - 1);
+        if (next == tailIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+        items[head] = item;
+        headIndex.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop (T &item) {
+        uint32_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail == headIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[tail];
+        tailIndex.store((tail + 1) & (Size - 1), std::memory_order_release);
+        return true;
+    }
+
+    bool empty () const {
+        return tailIndex.load(std::memory_order_acquire) == headIndex.load(std::memory_order_acquire);
+    }
+
+private:
+    T items[Size];
+    std::atomic<uint32_t> headIndex {0};
+    std::atomic<uint32_t> tailIndex {0};
+};
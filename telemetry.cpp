@@ -0,0 +1,84 @@
+#include "telemetry.h"
+#include "board.h"
+#include "config.h"
+#include "controller.h"
+#include "spscring.h"
+#include <cstdio>
+
+TelemetryStats telemetryStats {};
+static SpscRing<TelemetryFrame, MBED_CONF_APP_TELEMETRY_RING_SIZE> frames;
+static uint8_t sequence {};
+
+static int32_t saturate (float value, int32_t min, int32_t max) {
+    if (value >= max) {
+        return max;
+    }
+    if (value <= min) {
+        return min;
+    }
+    return (int32_t)value;
+}
+
+void recordTelemetry (bool master) {
+/*
+Called from the control loop, once per tick. Costs a few float-to-int conversions and a copy; never blocks.
+Frames only carry the first axis: more would mean a new frame layout, and the link doesn't have the bandwidth anyway.
+*/
+    const int axis {0};
+#if MBED_CONF_APP_FIXED_POINT_CONTROLLER
+    // Not while a move has it: the float state's the current one then, and the fixed-point copy is stale.
+    if (fixedStateCurrent(axis)) {
+        publishFixedState(axis);
+    }
+#endif
+    float command {axes.command[axis]};
+    TelemetryFrame frame;
+    frame.sync = telemetrySync;
+    frame.sequence = sequence++;
+    frame.flags = (master ? telemetryFlagMaster : 0)
+        | (command >= axes.outMax[axis] || command <= axes.outMin[axis] ? telemetryFlagAtLimit : 0)
+        | (MBED_CONF_APP_FIXED_POINT_CONTROLLER ? telemetryFlagFixed : 0);
+    frame.checksum = 0;
+    frame.timeUs = clockUs();
+    frame.inScaled = (int16_t)saturate(axes.inScaled[axis] * 16384, INT16_MIN, INT16_MAX);
+    frame.velocity = (int16_t)saturate(axes.velocity[axis] * 4194304, INT16_MIN, INT16_MAX);
+    frame.anticipatedAUC = (int16_t)saturate(axes.anticipatedAUC[axis] * 256, INT16_MIN, INT16_MAX);
+    frame.command = (uint16_t)saturate(command * 65535, 0, UINT16_MAX);
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&frame);
+    uint8_t sum {0};
+    for (unsigned i = 0; i < sizeof(frame); ++i) {
+        sum += bytes[i];
+    }
+    frame.checksum = -sum;
+    if (frames.push(frame)) {
+        ++telemetryStats.queued;
+    }
+    else {
+        ++telemetryStats.dropped;
+    }
+}
+
+void drainTelemetry () {
+// The background half: empties the ring a batch at a time. writeTelemetry() may block, which is fine down here.
+    TelemetryFrame batch[16];
+    while (true) {
+        unsigned count {0};
+        while (count < sizeof(batch) / sizeof(batch[0]) && frames.pop(batch[count])) {
+            ++count;
+        }
+        if (count == 0) {
+            return;
+        }
+        writeTelemetry(reinterpret_cast<const uint8_t *>(batch), count * sizeof(TelemetryFrame));
+        telemetryStats.sent += count;
+    }
+}
+
+void startTelemetry () {
+    startBackgroundTask(drainTelemetry, MBED_CONF_APP_TELEMETRY_DRAIN_MS);
+}
+
+void printTelemetryStats () {
+    printf("telemetry: %lu queued, %lu sent, %lu dropped\n", (unsigned long)telemetryStats.queued,
+           (unsigned long)telemetryStats.sent, (unsigned long)telemetryStats.dropped);
+}
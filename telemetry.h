@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+Binary telemetry: one 16-byte frame per control tick, queued from the control loop into a lock-free ring and
+written out by a low-priority background task, so streaming never holds up a tick. When the ring is full the
+frame is dropped and counted rather than waited for. tools/decode_telemetry.py turns a capture into CSV;
+if the layout or the scales here change, change them there too.
+
+Layout (little-endian):
+    0   uint8   0xA5, to find frame boundaries in a stream joined partway through
+    1   uint8   sequence number, wraps; gaps mean dropped frames
+    2   uint8   flags (see below)
+    3   uint8   checksum: whatever makes all 16 bytes sum to 0 mod 256
+    4   uint32  clockUs() at the end of the tick
+    8   int16   inScaled * 16384
+    10  int16   velocity * 4194304 (so +/-0.0078, comfortably past maxSpeed)
+    12  int16   anticipatedAUC * 256
+    14  uint16  command * 65535
+*/
+
+const uint8_t telemetrySync {0xA5};
+const uint8_t telemetryFlagMaster {1 << 0};  // fromMaster was high
+const uint8_t telemetryFlagAtLimit {1 << 1}; // command was pinned at outMin or outMax
+const uint8_t telemetryFlagFixed {1 << 2};   // the fixed-point engine was running
+
+struct TelemetryFrame {
+    uint8_t sync;
+    uint8_t sequence;
+    uint8_t flags;
+    uint8_t checksum;
+    uint32_t timeUs;
+    int16_t inScaled;
+    int16_t velocity;
+    int16_t anticipatedAUC;
+    uint16_t command;
+};
+static_assert(sizeof(TelemetryFrame) == 16, "TelemetryFrame has to stay packed to 16 bytes");
+
+struct TelemetryStats {
+    uint32_t queued;
+    uint32_t dropped; // Ring was full.
+    uint32_t sent;
+};
+
+extern TelemetryStats telemetryStats;
+
+void startTelemetry ();
+void recordTelemetry (bool master);
+void drainTelemetry ();
+void printTelemetryStats ();
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""
+Turns the binary telemetry stream (see telemetry.h for the frame layout) into CSV.
+
+    python3 tools/decode_telemetry.py capture.bin > capture.csv
+    python3 tools/decode_telemetry.py --serial /dev/ttyUSB0 --baud 460800 > live.csv   (needs pyserial)
+
+Frames with a bad checksum are skipped and the decoder hunts for the next sync byte, so a capture that starts
+mid-frame is fine. Gaps in the sequence number are counted as dropped frames (the firmware drops a frame when
+its ring is full, but still spends the sequence number). Counts go to stderr at the end.
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = 0xA5
+FRAME = struct.Struct("<BBBBIhhhH")
+FLAG_MASTER = 1 << 0
+FLAG_AT_LIMIT = 1 << 1
+FLAG_FIXED = 1 << 2
+
+
+def frames(chunks, stats):
+    buffer = bytearray()
+    for chunk in chunks:
+        buffer += chunk
+        start = 0
+        while len(buffer) - start >= FRAME.size:
+            if buffer[start] != SYNC:
+                start += 1
+                stats["skipped"] += 1
+                continue
+            raw = buffer[start:start + FRAME.size]
+            if sum(raw) & 0xFF != 0:
+                start += 1
+                stats["skipped"] += 1
+                stats["bad"] += 1
+                continue
+            start += FRAME.size
+            yield FRAME.unpack(raw)
+        del buffer[:start]
+
+
+def read_file(path):
+    with (sys.stdin.buffer if path == "-" else open(path, "rb")) as source:
+        while True:
+            chunk = source.read(65536)
+            if not chunk:
+                return
+            yield chunk
+
+
+def read_serial(port, baud):
+    import serial
+    with serial.Serial(port, baud, timeout=0.1) as source:
+        while True:
+            chunk = source.read(4096)
+            if chunk:
+                yield chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", nargs="?", default="-", help="binary capture file, or - for stdin")
+    parser.add_argument("--serial", help="read live from this serial port instead")
+    parser.add_argument("--baud", type=int, default=460800)
+    args = parser.parse_args()
+
+    stats = {"frames": 0, "dropped": 0, "bad": 0, "skipped": 0}
+    chunks = read_serial(args.serial, args.baud) if args.serial else read_file(args.capture)
+    out = sys.stdout
+    out.write("time_us,sequence,master,at_limit,fixed,inScaled,velocity,anticipatedAUC,command\n")
+    last_sequence = None
+    try:
+        for _, sequence, flags, _, time_us, in_scaled, velocity, auc, command in frames(chunks, stats):
+            if last_sequence is not None:
+                stats["dropped"] += (sequence - last_sequence - 1) & 0xFF
+            last_sequence = sequence
+            stats["frames"] += 1
+            out.write("%d,%d,%d,%d,%d,%.6f,%.8f,%.4f,%.6f\n" % (
+                time_us, sequence, bool(flags & FLAG_MASTER), bool(flags & FLAG_AT_LIMIT), bool(flags & FLAG_FIXED),
+                in_scaled / 16384.0, velocity / 4194304.0, auc / 256.0, command / 65535.0))
+    except KeyboardInterrupt:
+        pass
+    sys.stderr.write("%(frames)d frames, %(dropped)d dropped, %(bad)d bad checksums, %(skipped)d bytes skipped\n" % stats)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""
+Checks a build's ROM and RAM use against a baseline, from the linker's .map.
+
+    python3 tools/footprint.py BUILD/LPC1768/ARMC6/roboRock.map
+    python3 tools/footprint.py BUILD/LPC1768/ARMC6/roboRock.map --update    (accept the new sizes as the baseline)
+
+ROM is everything that goes in flash (code, read-only data, and the initial values of RW data); RAM is the static
+RAM (RW and zero-initialized data, stacks and heap reserved by the linker included). Both ARMC6 maps (the totals at
+the end) and GCC_ARM maps (the output sections) work. If mbed's memap output (<name>_map.json) sits next to the map,
+the modules that changed are listed too.
+Any growth past the tolerance fails: the numbers go to stderr with a banner, and the exit status is 1. Growth is
+sometimes the point, so after checking it's expected, --update takes it as the new baseline.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+BASELINE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "footprint_baseline.json")
+
+
+def armc6_totals(text):
+    ro = re.search(r"Total RO\s+Size \(Code \+ RO Data\)\s+(\d+)", text)
+    rw = re.search(r"Total RW\s+Size \(RW Data \+ ZI Data\)\s+(\d+)", text)
+    rom = re.search(r"Total ROM Size \(Code \+ RO Data \+ RW Data\)\s+(\d+)", text)
+    if not (ro and rw and rom):
+        return None
+    return {"rom": int(rom.group(1)), "ram": int(rw.group(1))}
+
+
+def gnu_totals(text):
+    # Output sections are the unindented lines: name, address, size. A long name puts the numbers on the next line.
+    sizes = {}
+    for match in re.finditer(r"^(\.[\w.]+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)", text, re.MULTILINE):
+        sizes[match.group(1)] = sizes.get(match.group(1), 0) + int(match.group(3), 16)
+    if ".text" not in sizes:
+        return None
+    flash = [".isr_vector", ".text", ".ARM.extab", ".ARM.exidx", ".rodata", ".data"]
+    ram = [".data", ".bss", ".heap", ".stack_dummy", ".stack"]
+    return {"rom": sum(sizes.get(name, 0) for name in flash), "ram": sum(sizes.get(name, 0) for name in ram)}
+
+
+def modules(map_path):
+    memap = re.sub(r"\.map$", "_map.json", map_path)
+    if not os.path.exists(memap):
+        return {}
+    with open(memap) as source:
+        return {entry["module"]: entry["size"].get(".text", 0) + entry["size"].get(".data", 0)
+                + entry["size"].get(".bss", 0) for entry in json.load(source) if "module" in entry}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("map", help="the linker map, e.g. BUILD/LPC1768/ARMC6/roboRock.map")
+    parser.add_argument("--baseline", default=BASELINE)
+    parser.add_argument("--tolerance", type=int, default=0, help="bytes of growth to let through (default 0)")
+    parser.add_argument("--update", action="store_true", help="write this build's sizes to the baseline and pass")
+    args = parser.parse_args()
+
+    with open(args.map, errors="replace") as source:
+        text = source.read()
+    totals = armc6_totals(text) or gnu_totals(text)
+    if totals is None:
+        sys.exit("%s: doesn't look like an ARMC6 or GCC_ARM map" % args.map)
+    totals["modules"] = modules(args.map)
+
+    if args.update or not os.path.exists(args.baseline):
+        with open(args.baseline, "w") as out:
+            json.dump(totals, out, indent=4, sort_keys=True)
+            out.write("\n")
+        print("ROM %d, RAM %d bytes: written to %s" % (totals["rom"], totals["ram"], args.baseline))
+        return
+
+    with open(args.baseline) as source:
+        baseline = json.load(source)
+    failed = []
+    for key in ("rom", "ram"):
+        change = totals[key] - baseline[key]
+        print("%s %6d bytes (baseline %d, %+d)" % (key.upper(), totals[key], baseline[key], change))
+        if change > args.tolerance:
+            failed.append("%s grew by %d bytes" % (key.upper(), change))
+    was = baseline.get("modules", {})
+    for name in sorted(set(was) | set(totals["modules"])):
+        change = totals["modules"].get(name, 0) - was.get(name, 0)
+        if change != 0 and was and totals["modules"]:
+            print("  %-40s %+d" % (name, change))
+    if failed:
+        sys.stderr.write("\n*** footprint FAILED: %s (tolerance %d). If that's expected, rerun with --update. ***\n"
+                         % ("; ".join(failed), args.tolerance))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""
+Solves the model-predictive compliance mode's gains (see mpc.h) offline, and writes them out as mpcgains.h.
+
+    python3 tools/mpc_gains.py                                  (the factory slickness; rewrites mpcgains.h)
+    python3 tools/mpc_gains.py --slickness 0.995 --effort 10 -o -   (to stdout, to look at)
+
+Over a horizon of N ticks, with the force carried on at its current rate, the actuator's velocity v should follow
+the virtual mass-damper's, w:
+
+    w[0] = v[0]        w[i+1] = slickness * w[i] + forceGain / inertia * (force + i * rate)
+    v[i+1] = v[i] + u[i]
+    minimize  sum over i = 1..N of (v[i] - w[i])^2  +  effort * sum over i = 0..N-1 of u[i]^2
+
+The velocities are v[0] plus running sums of u, so with e = L u + c (L lower triangular, all ones), the answer is
+u = -(L'L + effort I)^-1 L' c. c is linear in v[0], force and rate, so the first step, u[0], is too: three gains.
+Only u[0] is used on target, so only those go in the table, one row per horizon. The force gains are for an inertia
+of 1; the controller divides by the real one.
+No numpy: it's a 40x40 solve at most, so plain Gaussian elimination does.
+"""
+
+import argparse
+import os
+import sys
+
+HEADER = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), "mpcgains.h")
+
+
+def solve(matrix, vector):
+    # Gaussian elimination with partial pivoting; matrix is symmetric positive definite here, so it's well behaved.
+    n = len(vector)
+    rows = [matrix[i][:] + [vector[i]] for i in range(n)]
+    for column in range(n):
+        pivot = max(range(column, n), key=lambda r: abs(rows[r][column]))
+        rows[column], rows[pivot] = rows[pivot], rows[column]
+        for r in range(n):
+            if r != column:
+                factor = rows[r][column] / rows[column][column]
+                for k in range(column, n + 1):
+                    rows[r][k] -= factor * rows[column][k]
+    return [rows[i][n] / rows[i][i] for i in range(n)]
+
+
+def literal(value):
+    # A C++ float literal: "30f" isn't one, so there has to be a point or an exponent.
+    text = "%.9g" % value
+    if "." not in text and "e" not in text:
+        text += ".0"
+    return text + "f"
+
+
+def first_step_gains(horizon, slickness, effort, force_gain):
+    # (L'L)[i][j] is how many of the N running sums include both u[i] and u[j]: N - max(i, j).
+    normal = [[horizon - max(i, j) + (effort if i == j else 0) for j in range(horizon)] for i in range(horizon)]
+    # Row 0 of (L'L + effort I)^-1 L' is (L z)' where z solves the (symmetric) system against the first unit vector.
+    z = solve(normal, [1.0] + [0.0] * (horizon - 1))
+    row = [sum(z[:i]) for i in range(1, horizon + 1)]
+    # c[i] = (1 - slickness^i) v - forceGain * (a[i] force + b[i] rate), for i = 1..N.
+    decay = [1 - slickness ** i for i in range(1, horizon + 1)]
+    level = [sum(slickness ** (i - 1 - j) for j in range(i)) for i in range(1, horizon + 1)]
+    ramp = [sum(j * slickness ** (i - 1 - j) for j in range(i)) for i in range(1, horizon + 1)]
+    dot = lambda a, b: sum(x * y for x, y in zip(a, b))
+    return -dot(row, decay), force_gain * dot(row, level), force_gain * dot(row, ramp)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--slickness", type=float, default=0.999, help="must match FactoryTuning (default 0.999)")
+    parser.add_argument("--effort", type=float, default=30,
+                        help="weight on acceleration against velocity error; higher is smoother and looks further "
+                             "ahead (default 30)")
+    # comply()'s gain on a steady force, at rest and with the factory horizon: 2.4 (the AUC's weights over 21+3
+    # points, all divided by 10) * 0.007 / 20^2.
+    parser.add_argument("--force-gain", type=float, default=4.2e-5,
+                        help="acceleration per tick for a force of 1 at an inertia of 1 (default 4.2e-5)")
+    parser.add_argument("--horizons", default="5,10,20,40", help="one row each, ascending (default 5,10,20,40)")
+    parser.add_argument("-o", "--output", default=HEADER, help="where to write it; - for stdout (default mpcgains.h)")
+    args = parser.parse_args()
+
+    horizons = sorted(int(h) for h in args.horizons.split(","))
+    rows = []
+    for horizon in horizons:
+        velocity, force, rate = first_step_gains(horizon, args.slickness, args.effort, args.force_gain)
+        rows.append("    {%d, %s, %s, %s}," % (horizon, literal(velocity), literal(force), literal(rate)))
+    text = "\n".join([
+        "#pragma once",
+        "",
+        "#include \"mpc.h\"",
+        "",
+        "// Generated by: tools/mpc_gains.py --slickness %g --effort %g --force-gain %g --horizons %s"
+        % (args.slickness, args.effort, args.force_gain, ",".join(str(h) for h in horizons)),
+        "// Don't edit; rerun it. One row per horizon: horizon, then the gains on velocity, force and forceRate().",
+        "",
+        "constexpr float mpcSlickness {%s};" % literal(args.slickness),
+        "constexpr float mpcEffortWeight {%s};" % literal(args.effort),
+        "constexpr float mpcForceGain {%s};" % literal(args.force_gain),
+        "const int mpcHorizonCount {%d};" % len(horizons),
+        "const MpcGains mpcGains[mpcHorizonCount] {",
+    ] + rows + ["};", ""])
+    if args.output == "-":
+        sys.stdout.write(text)
+        return
+    with open(args.output, "w") as out:
+        out.write(text)
+    print("%d horizons written to %s" % (len(horizons), args.output))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,82 @@
+#include "trajectory.h"
+#include <cmath>
+
+static float rampDistance (float speed, const MotionLimits &limits) {
+// How far it takes to get from rest up to speed (or back down): the area under a symmetric S.
+    float jerkLimited = limits.acceleration * limits.acceleration / limits.jerk;
+    if (speed >= jerkLimited) {
+        return speed * (speed / limits.acceleration + limits.acceleration / limits.jerk) / 2;
+    }
+    return speed * sqrtf(speed / limits.jerk);
+}
+
+Trajectory planTrajectory (float from, float to, const MotionLimits &limits) {
+    Trajectory plan {};
+    plan.from = from;
+    plan.to = to;
+    float distance = fabsf(to - from);
+    if (distance == 0 || limits.speed <= 0 || limits.acceleration <= 0 || limits.jerk <= 0) {
+        plan.duration = 0;
+        for (int i = 1; i < 8; ++i) {
+            plan.segmentStart[i] = 0;
+        }
+        return plan;
+    }
+
+    // Top speed: the limit, unless ramping up to it and back down again would already overshoot.
+    float speed = limits.speed;
+    if (2 * rampDistance(speed, limits) > distance) {
+        // Solve 2 * rampDistance(v) = distance for v, first assuming acceleration saturates...
+        float jerkLimited = limits.acceleration * limits.acceleration / limits.jerk;
+        speed = (-jerkLimited + sqrtf(jerkLimited * jerkLimited + 4 * limits.acceleration * distance)) / 2;
+        // ...and if it wouldn't have, with pure jerk ramps: 2 * v * sqrt(v / jerk) = distance.
+        if (speed < jerkLimited) {
+            speed = powf(distance * sqrtf(limits.jerk) / 2, 2.0f / 3);
+        }
+    }
+    float rampJerkTime = sqrtf(speed / limits.jerk);
+    float rampHoldTime {0};
+    if (rampJerkTime * limits.jerk > limits.acceleration) {
+        rampJerkTime = limits.acceleration / limits.jerk;
+        rampHoldTime = speed / limits.acceleration - rampJerkTime;
+    }
+    float cruiseTime = (distance - 2 * rampDistance(speed, limits)) / speed;
+    if (cruiseTime < 0) {
+        cruiseTime = 0;
+    }
+
+    const float lengths[7] {rampJerkTime, rampHoldTime, rampJerkTime, cruiseTime, rampJerkTime, rampHoldTime, rampJerkTime};
+    const float jerks[7] {limits.jerk, 0, -limits.jerk, 0, -limits.jerk, 0, limits.jerk};
+    plan.peakSpeed = speed;
+    plan.segmentStart[0] = plan.segmentPosition[0] = plan.segmentSpeed[0] = plan.segmentAcceleration[0] = 0;
+    for (int i = 0; i < 7; ++i) {
+        float t = lengths[i];
+        float j = jerks[i];
+        float a = plan.segmentAcceleration[i];
+        float v = plan.segmentSpeed[i];
+        plan.segmentJerk[i] = j;
+        plan.segmentStart[i + 1] = plan.segmentStart[i] + t;
+        plan.segmentPosition[i + 1] = plan.segmentPosition[i] + v * t + a * t * t / 2 + j * t * t * t / 6;
+        plan.segmentSpeed[i + 1] = v + a * t + j * t * t / 2;
+        plan.segmentAcceleration[i + 1] = a + j * t;
+    }
+    plan.duration = plan.segmentStart[7];
+    return plan;
+}
+
+float trajectoryPosition (const Trajectory &plan, float tick) {
+    if (tick >= plan.duration) {
+        return plan.to;
+    }
+    if (tick <= 0) {
+        return plan.from;
+    }
+    int i {6};
+    while (i > 0 && tick < plan.segmentStart[i]) {
+        --i;
+    }
+    float t = tick - plan.segmentStart[i];
+    float along = plan.segmentPosition[i] + plan.segmentSpeed[i] * t + plan.segmentAcceleration[i] * t * t / 2
+        + plan.segmentJerk[i] * t * t * t / 6;
+    return plan.to > plan.from ? plan.from + along : plan.from - along;
+}
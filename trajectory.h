@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+Jerk-limited ("S-curve") point-to-point motion. Everything is in control ticks and 0-1 position units, the same
+as maxSpeed and maxAcceleration, so a trajectory can be read off once per tick with no conversions.
+A plan is rest-to-rest and time-optimal within the limits: jerk up to full acceleration, hold it, jerk back
+down to cruising speed, cruise, and the mirror image to stop. Short moves drop the cruise and, if need be, never
+reach full acceleration or full speed.
+*/
+
+struct MotionLimits {
+    float speed;
+    float acceleration;
+    float jerk;
+};
+
+struct Trajectory {
+    float from;
+    float to;
+    float duration;      // Ticks.
+    float peakSpeed;
+    // Where each of the seven segments starts: time, position (relative to from, along the direction of travel),
+    // speed and acceleration. The eighth entry is the end.
+    float segmentStart[8];
+    float segmentPosition[8];
+    float segmentSpeed[8];
+    float segmentAcceleration[8];
+    float segmentJerk[7];
+};
+
+Trajectory planTrajectory (float from, float to, const MotionLimits &limits);
+float trajectoryPosition (const Trajectory &trajectory, float tick);